@@ -4,18 +4,22 @@
 #include <algorithm>
 #include <array>
 #include <chrono>
+#include <cstdio>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "assert.h"
 #include "benchmark_metrics.h"
 #include "graph.h"
 #include "macro_utils.h"
+#include "mcts.h"
 #include "negamax.h"
+#include "nnue.h"
 #include "situation.h"
 #include "tests.h"
 #include "utils.h"
@@ -26,7 +30,11 @@ namespace benchmark_internal {
 
 BenchmarkMetrics AverageMetrics(const std::vector<BenchmarkMetrics>& samples) {
   BenchmarkMetrics avg = {};
+  avg.max_completed_depth = kMaxDepth;
   for (const auto& sample : samples) {
+    // A depth is only considered completed if it was in every sample.
+    avg.max_completed_depth =
+        std::min(avg.max_completed_depth, sample.max_completed_depth);
     avg.wall_clock_time_ms += sample.wall_clock_time_ms;
     avg.graph_primitives += sample.graph_primitives;
     for (int depth = 0; depth <= kMaxDepth; ++depth) {
@@ -37,8 +45,35 @@ BenchmarkMetrics AverageMetrics(const std::vector<BenchmarkMetrics>& samples) {
       avg.tt_useless_reads[depth] += sample.tt_useless_reads[depth];
       avg.tt_add_writes[depth] += sample.tt_add_writes[depth];
       avg.tt_replace_writes[depth] += sample.tt_replace_writes[depth];
+      avg.tt_rejected_writes[depth] += sample.tt_rejected_writes[depth];
       avg.generated_children[depth] += sample.generated_children[depth];
+      avg.completed_depth_millis[depth] += sample.completed_depth_millis[depth];
+      avg.tt_probes[depth] += sample.tt_probes[depth];
+      avg.tt_found_reads[depth] += sample.tt_found_reads[depth];
+      avg.tt_collision_reads[depth] += sample.tt_collision_reads[depth];
+      avg.tt_mirrored_reads[depth] += sample.tt_mirrored_reads[depth];
+      avg.pvs_researches[depth] += sample.pvs_researches[depth];
+      avg.lmr_reductions[depth] += sample.lmr_reductions[depth];
+      avg.lmr_researches[depth] += sample.lmr_researches[depth];
+      avg.futility_prunes[depth] += sample.futility_prunes[depth];
+      for (int type = 0; type < kNumCutoffMoveTypes; ++type)
+        avg.cutoff_moves[depth][type] += sample.cutoff_moves[depth][type];
+      avg.cutoff_index_sum[depth] += sample.cutoff_index_sum[depth];
     }
+    avg.aspiration_researches += sample.aspiration_researches;
+    avg.mtdf_searches += sample.mtdf_searches;
+    avg.race_solves += sample.race_solves;
+    avg.quiescence_nodes += sample.quiescence_nodes;
+    avg.quiescence_wins += sample.quiescence_wins;
+    avg.eval_cache_probes += sample.eval_cache_probes;
+    avg.eval_cache_hits += sample.eval_cache_hits;
+    avg.eval_cache_saved_primitives += sample.eval_cache_saved_primitives;
+    avg.etc_probes += sample.etc_probes;
+    avg.etc_cutoffs += sample.etc_cutoffs;
+    avg.iid_searches += sample.iid_searches;
+    avg.iid_move_cutoffs += sample.iid_move_cutoffs;
+    avg.null_move_searches += sample.null_move_searches;
+    avg.null_move_cutoffs += sample.null_move_cutoffs;
   }
   int n = samples.size();
   avg.wall_clock_time_ms /= n;
@@ -51,8 +86,35 @@ BenchmarkMetrics AverageMetrics(const std::vector<BenchmarkMetrics>& samples) {
     avg.tt_useless_reads[depth] /= n;
     avg.tt_add_writes[depth] /= n;
     avg.tt_replace_writes[depth] /= n;
+    avg.tt_rejected_writes[depth] /= n;
     avg.generated_children[depth] /= n;
+    avg.completed_depth_millis[depth] /= n;
+    avg.tt_probes[depth] /= n;
+    avg.tt_found_reads[depth] /= n;
+    avg.tt_collision_reads[depth] /= n;
+    avg.tt_mirrored_reads[depth] /= n;
+    avg.pvs_researches[depth] /= n;
+    avg.lmr_reductions[depth] /= n;
+    avg.lmr_researches[depth] /= n;
+    avg.futility_prunes[depth] /= n;
+    for (int type = 0; type < kNumCutoffMoveTypes; ++type)
+      avg.cutoff_moves[depth][type] /= n;
+    avg.cutoff_index_sum[depth] /= n;
   }
+  avg.aspiration_researches /= n;
+  avg.mtdf_searches /= n;
+  avg.race_solves /= n;
+  avg.quiescence_nodes /= n;
+  avg.quiescence_wins /= n;
+  avg.eval_cache_probes /= n;
+  avg.eval_cache_hits /= n;
+  avg.eval_cache_saved_primitives /= n;
+  avg.etc_probes /= n;
+  avg.etc_cutoffs /= n;
+  avg.iid_searches /= n;
+  avg.iid_move_cutoffs /= n;
+  avg.null_move_searches /= n;
+  avg.null_move_cutoffs /= n;
   return avg;
 }
 
@@ -67,6 +129,7 @@ std::string BenchmarkSettings(std::string description, std::string timestamp) {
        << "Negamax search time (ms): " << kBenchmarksearchTimeMillis << '\n'
        << "Negamax max depth: " << kMaxDepth << '\n'
        << "TT size (MB): " << kTranspositionTableMB << '\n'
+       << "Hardware threads: " << std::thread::hardware_concurrency() << '\n'
        << "Sizes (bytes): Move: " << sizeof(Move) << " int: " << sizeof(int)
        << '\n';
   return sout.str();
@@ -86,6 +149,9 @@ std::string DimensionsSettings() {
   return sout.str();
 }
 
+// Number of TT entries sampled for the TT contents report.
+constexpr long long kTTStatisticsSamples = 1 << 20;
+
 const std::vector<std::string> kCsvColumns = {"situation",
                                               "move",
                                               "runtime_ms",
@@ -106,7 +172,37 @@ const std::vector<std::string> kCsvColumns = {"situation",
                                               "tt_no_writes",
                                               "generated_children",
                                               "visited_children",
-                                              "pruned_children"};
+                                              "pruned_children",
+                                              "tt_found_reads",
+                                              "tt_collision_reads",
+                                              "nodes",
+                                              "completed_depth_millis",
+                                              "pvs_researches",
+                                              "aspiration_researches",
+                                              "tt_move_cutoffs",
+                                              "double_walk_cutoffs",
+                                              "first_move_cutoffs",
+                                              "second_move_cutoffs",
+                                              "third_move_cutoffs",
+                                              "early_move_cutoffs",
+                                              "late_move_cutoffs",
+                                              "cutoff_index_sum",
+                                              "lmr_reductions",
+                                              "lmr_researches",
+                                              "futility_prunes",
+                                              "quiescence_nodes",
+                                              "quiescence_wins",
+                                              "mtdf_searches",
+                                              "race_solves",
+                                              "eval_cache_probes",
+                                              "eval_cache_hits",
+                                              "eval_cache_saved_primitives",
+                                              "etc_probes",
+                                              "etc_cutoffs",
+                                              "iid_searches",
+                                              "iid_move_cutoffs",
+                                              "null_move_searches",
+                                              "null_move_cutoffs"};
 
 std::string CsvHeaderRow() {
   std::ostringstream sout;
@@ -127,12 +223,48 @@ std::string CsvRow(const std::string& sit_name, const std::string& move,
   for (int i = 0; i < kNumTTReadTypes; ++i) sout << "," << m.TTReadsOfType(i);
   for (int i = 0; i < kNumTTWriteTypes; ++i) sout << "," << m.TTWritesOfType(i);
   sout << "," << m.TotalGeneratedChildren() << "," << m.TotalVisitedChildren()
-       << "," << m.TotalPrunedChildren() << std::endl;
+       << "," << m.TotalPrunedChildren() << "," << m.TotalTTFoundReads() << ","
+       << m.TotalTTCollisionReads() << "," << m.TotalExits() << ",";
+  // The time to complete each depth, starting at 1, separated by ';'.
+  for (int depth = 1; depth <= m.max_completed_depth; ++depth) {
+    if (depth > 1) sout << ";";
+    sout << m.completed_depth_millis[depth];
+  }
+  sout << "," << m.TotalPVSResearches() << "," << m.aspiration_researches;
+  for (int i = 0; i < kNumCutoffMoveTypes; ++i)
+    sout << "," << m.CutoffsOfType(i);
+  sout << "," << m.TotalCutoffIndexSum() << "," << m.TotalLMRReductions()
+       << "," << m.TotalLMRResearches() << "," << m.TotalFutilityPrunes()
+       << "," << m.quiescence_nodes << "," << m.quiescence_wins << ","
+       << m.mtdf_searches << "," << m.race_solves << ","
+       << m.eval_cache_probes << "," << m.eval_cache_hits << ","
+       << m.eval_cache_saved_primitives << "," << m.etc_probes << ","
+       << m.etc_cutoffs << "," << m.iid_searches << "," << m.iid_move_cutoffs
+       << "," << m.null_move_searches << "," << m.null_move_cutoffs
+       << std::endl;
   return sout.str();
 }
 
 double Percentage(double x, double total) { return 100.0 * x / total; }
 
+// Inverse of the encoding of the `completed_depth_millis` csv column.
+std::vector<long long> ParseCompletedDepthMillis(const std::string& s) {
+  std::vector<long long> res;
+  std::istringstream sin(s);
+  std::string millis;
+  while (std::getline(sin, millis, ';')) res.push_back(std::stoll(millis));
+  return res;
+}
+
+// Change from `prev` to `curr` as a percentage of `prev`, or "" if either is
+// missing, e.g., in csv files from older versions of the benchmark.
+std::string PercentChange(const std::string& prev, const std::string& curr) {
+  if (prev.empty() || curr.empty() || std::stoll(prev) == 0) return "";
+  double change =
+      Percentage(std::stoll(curr) - std::stoll(prev), std::stoll(prev));
+  return (change > 0 ? "+" : "") + ToStringWithPrecision(change, 1) + "%";
+}
+
 // One column per exit type and one row per depth, with 2 special rows at the
 // end: one with the sum across depths, and one with the sums from
 // `prev_csv`, if provided.
@@ -332,6 +464,127 @@ std::string ChildGenerationTable(std::map<std::string, std::string> prev_csv,
   return sout.str();
 }
 
+void AddCutoffMovesRow(const std::string& row_name,
+                       const std::array<long long, kNumCutoffMoveTypes>& counts,
+                       long long index_sum, StrTable& table) {
+  long long total = 0;
+  for (long long count : counts) total += count;
+  table.AddToNewRow(row_name);
+  table.AddToLastRow(total);
+  table.AddToLastRow("|");
+  for (long long count : counts)
+    table.AddToLastRow(Percentage(count, total), 1);
+  // Average index among the cutoffs by moves from `OrderedMoves`.
+  long long ordered_total = total - counts[TT_MOVE_CUTOFF] -
+                            counts[DOUBLE_WALK_CUTOFF];
+  if (ordered_total > 0) {
+    table.AddToLastRow(static_cast<double>(index_sum) / ordered_total, 2);
+  } else {
+    table.AddToLastRow("-");
+  }
+}
+
+// One row per depth with the percentage of beta cutoffs caused by each move,
+// by the order in which moves are tried, and the average index in
+// `OrderedMoves` of the cutoff moves that come from it.
+std::string CutoffMovesTable(std::map<std::string, std::string> prev_csv,
+                             const BenchmarkMetrics& m) {
+  StrTable table;
+  table.AddToNewRow({"Depth", "Cutoffs", "|", "tt_move%", "double_walk%",
+                     "1st%", "2nd%", "3rd%", "4th-8th%", "later%",
+                     "avg_index"});
+  for (int depth = kMaxDepth; depth >= 1; --depth) {
+    if (m.CutoffsAtDepth(depth) == 0) continue;
+    AddCutoffMovesRow(std::to_string(depth), m.cutoff_moves[depth],
+                      m.cutoff_index_sum[depth], table);
+  }
+  table.AddHorizontalLineRow();
+  {
+    std::array<long long, kNumCutoffMoveTypes> counts;
+    for (int type = 0; type < kNumCutoffMoveTypes; ++type)
+      counts[type] = m.CutoffsOfType(type);
+    AddCutoffMovesRow("Sum", counts, m.TotalCutoffIndexSum(), table);
+  }
+  // Older csv files do not have these columns.
+  if (prev_csv.count("cutoff_index_sum") > 0) {
+    const std::array<std::string, kNumCutoffMoveTypes> columns = {
+        "tt_move_cutoffs",    "double_walk_cutoffs", "first_move_cutoffs",
+        "second_move_cutoffs", "third_move_cutoffs", "early_move_cutoffs",
+        "late_move_cutoffs"};
+    std::array<long long, kNumCutoffMoveTypes> counts;
+    for (int type = 0; type < kNumCutoffMoveTypes; ++type)
+      counts[type] = std::stoll(prev_csv[columns[type]]);
+    AddCutoffMovesRow("Prev", counts, std::stoll(prev_csv["cutoff_index_sum"]),
+                      table);
+  }
+  std::ostringstream sout;
+  sout << "Beta cutoffs by cutoff move:\n";
+  table.Print(sout, 2);
+  return sout.str();
+}
+
+// Describes how full the TT is and what it contains, based on a sample of its
+// entries at the end of the search, and how often probes during the search
+// found their situation versus a different situation in the same slot.
+std::string TTContentsReport(const TTStatistics& stats,
+                             const BenchmarkMetrics& m) {
+  std::ostringstream sout;
+  long long live = stats.num_live_entries;
+  sout << "Transposition table contents (" << stats.num_sampled_entries
+       << " sampled entries):\n"
+       << "Occupancy: " << live << " ("
+       << ToStringWithPrecision(Percentage(live, stats.num_sampled_entries), 2)
+       << "%)\n";
+  {
+    StrTable table;
+    table.AddToNewRow({"Depth", "Entries", "%"});
+    for (int depth = kMaxDepth; depth >= 0; --depth) {
+      if (stats.depths[depth] == 0) continue;
+      table.AddToNewRow(depth);
+      table.AddToLastRow(stats.depths[depth]);
+      table.AddToLastRow(Percentage(stats.depths[depth], live), 1);
+    }
+    table.Print(sout, 2);
+  }
+  {
+    StrTable table;
+    table.AddToNewRow({"Flag", "Entries", "%"});
+    const std::array<std::string, 4> flag_names = {"empty", "exact", "lower",
+                                                   "upper"};
+    for (int flag = kExactFlag; flag <= kUpperboundFlag; ++flag) {
+      table.AddToNewRow(flag_names[flag]);
+      table.AddToLastRow(stats.flags[flag]);
+      table.AddToLastRow(Percentage(stats.flags[flag], live), 1);
+    }
+    table.Print(sout, 2);
+  }
+  {
+    StrTable table;
+    table.AddToNewRow({"Age", "Entries", "%"});
+    for (int age = 0; age < kNumTTAgeBuckets; ++age) {
+      std::string age_str = std::to_string(age);
+      if (age == kNumTTAgeBuckets - 1) age_str += "+";
+      table.AddToNewRow(age_str);
+      table.AddToLastRow(stats.ages[age]);
+      table.AddToLastRow(Percentage(stats.ages[age], live), 1);
+    }
+    table.Print(sout, 2);
+  }
+  long long found = m.TotalTTFoundReads();
+  long long collisions = m.TotalTTCollisionReads();
+  long long probes = m.TotalTTProbes();
+  sout << "Probes: " << probes << " | found: " << found << " ("
+       << ToStringWithPrecision(Percentage(found, probes), 2)
+       << "%) | slot holds another situation: " << collisions << " ("
+       << ToStringWithPrecision(Percentage(collisions, probes), 2)
+       << "%) | empty slot: " << probes - found - collisions << '\n';
+  long long mirrored = m.TotalTTMirroredReads();
+  sout << "Found entries stored by the mirror image of the situation: "
+       << mirrored << " ("
+       << ToStringWithPrecision(Percentage(mirrored, found), 2) << "%)\n";
+  return sout.str();
+}
+
 // Returns all the values in a column across two tables, without duplicates.
 // Skips first (header) row in each table. Preserves the order of table1,
 // followed by new entries from table 2 in order.
@@ -362,7 +615,8 @@ std::string ComparisonTable(
     std::map<std::string, std::map<std::string, std::string>> curr_csv_map) {
   StrTable table;
   table.AddToNewRow({"Situation", "|", "move", "", "|", "time", "", "|",
-                     "graph_p", "", "|", "visited", "", "|", "pruned", ""});
+                     "graph_p", "", "|", "visited", "", "|", "pruned", "", "|",
+                     "nodes", "", "", "|", "time to depth", "", "", ""});
 
   std::vector<std::string> sits =
       ColumnUnion(prev_csv_table, curr_csv_table, 0);
@@ -375,7 +629,21 @@ std::string ComparisonTable(
          prev_map["runtime_ms"], curr_map["runtime_ms"], "|",
          prev_map["graph_primitives"], curr_map["graph_primitives"], "|",
          prev_map["visited_children"], curr_map["visited_children"], "|",
-         prev_map["pruned_children"], curr_map["pruned_children"]});
+         prev_map["pruned_children"], curr_map["pruned_children"], "|",
+         prev_map["nodes"], curr_map["nodes"],
+         PercentChange(prev_map["nodes"], curr_map["nodes"]), "|"});
+    // Time to complete the deepest depth completed by both.
+    std::vector<long long> prev_millis =
+        ParseCompletedDepthMillis(prev_map["completed_depth_millis"]);
+    std::vector<long long> curr_millis =
+        ParseCompletedDepthMillis(curr_map["completed_depth_millis"]);
+    std::size_t depth = std::min(prev_millis.size(), curr_millis.size());
+    if (depth > 0) {
+      std::string prev_ms = std::to_string(prev_millis[depth - 1]);
+      std::string curr_ms = std::to_string(curr_millis[depth - 1]);
+      table.AddToLastRow({"d" + std::to_string(depth), prev_ms, curr_ms,
+                          PercentChange(prev_ms, curr_ms)});
+    }
     if (prev_map["move"] != curr_map["move"]) diff_move = true;
   }
 
@@ -398,10 +666,32 @@ std::string BenchmarkMetricsReport(
   long long gp = m.graph_primitives;
   sout << "Duration (ms): " << ms << '\n' << "Graph primitives: " << gp;
   if (ms > 0) sout << " (" << gp / ms << "/ms)";
+  sout << "\nPVS re-searches: " << m.TotalPVSResearches()
+       << "\nAspiration window re-searches: " << m.aspiration_researches
+       << "\nLate move reductions: " << m.TotalLMRReductions()
+       << " (re-searched: " << m.TotalLMRResearches() << ")"
+       << "\nFutility prunes and razoring: " << m.TotalFutilityPrunes()
+       << "\nQuiescence nodes: " << m.quiescence_nodes
+       << " (wins found: " << m.quiescence_wins << ")"
+       << "\nMTD(f) root searches: " << m.mtdf_searches
+       << "\nRace solves: " << m.race_solves
+       << "\nEvaluation cache hits: " << m.eval_cache_hits << " / "
+       << m.eval_cache_probes;
+  if (m.eval_cache_probes > 0)
+    sout << " (" << 100 * m.eval_cache_hits / m.eval_cache_probes << "%)";
+  sout << "\nGraph primitives saved by the evaluation cache: "
+       << m.eval_cache_saved_primitives
+       << "\nEnhanced transposition cutoffs: " << m.etc_cutoffs
+       << " (TT probes: " << m.etc_probes << ")"
+       << "\nInternal iterative deepening searches: " << m.iid_searches
+       << " (cutoffs by their move: " << m.iid_move_cutoffs << ")"
+       << "\nNull-move searches: " << m.null_move_searches
+       << " (cutoffs: " << m.null_move_cutoffs << ")";
   sout << "\n\n"
        << ExitTypeTable(prev_csv, m) << '\n'
        << TTReadWriteTables(prev_csv, m) << '\n'
-       << ChildGenerationTable(prev_csv, m);
+       << ChildGenerationTable(prev_csv, m) << '\n'
+       << CutoffMovesTable(prev_csv, m);
   return sout.str();
 }
 
@@ -459,11 +749,12 @@ std::map<std::string, std::map<std::string, std::string>> CsvMap(
 }
 
 template <int R, int C>
-std::pair<Move, BenchmarkMetrics> GetMoveWithMetrics(Negamax<R, C>& negamax,
-                                                     Situation<R, C> sit) {
+std::pair<Move, BenchmarkMetrics> GetMoveWithMetrics(
+    Negamax<R, C>& negamax, Situation<R, C> sit,
+    int max_depth = kMaxDepth - 1) {
   global_metrics = {};
   auto start = std::chrono::high_resolution_clock::now();
-  Move move = negamax.GetMove(sit, kBenchmarksearchTimeMillis);
+  Move move = negamax.GetMove(sit, kBenchmarksearchTimeMillis, max_depth);
   auto stop = std::chrono::high_resolution_clock::now();
   global_metrics.wall_clock_time_ms =
       std::chrono::duration_cast<std::chrono::milliseconds>(stop - start)
@@ -472,6 +763,7 @@ std::pair<Move, BenchmarkMetrics> GetMoveWithMetrics(Negamax<R, C>& negamax,
 }
 
 struct BenchmarkContext {
+  const std::string& benchmark_dir;
   std::ostream& report_out;
   std::ostream& csv_out;
   std::map<std::string, std::map<std::string, std::string>>& prev_csv_map;
@@ -492,8 +784,11 @@ void BenchmarkSituation(BenchmarkContext& context,
   std::vector<BenchmarkMetrics> samples;
   std::string first_move = "";
   StreamAndStdOut(context.report_out, "Situation: " + input.sit_name);
+  // The TT is reused across samples. Clearing it is O(1), so samples do not pay
+  // for reallocating and reinitializing it.
+  Negamax<R, C> negamaxer;
   for (int i = 0; i < kBenchmarkNumSamples; ++i) {
-    Negamax<R, C> negamaxer;
+    negamaxer.ClearTT();
     auto move_metrics = GetMoveWithMetrics<R, C>(negamaxer, sit);
     std::string move = sit.MoveToStandardNotation(move_metrics.first);
     if (i == 0) first_move = move;
@@ -510,41 +805,529 @@ void BenchmarkSituation(BenchmarkContext& context,
   std::string report =
       BenchmarkMetricsReport(context.prev_csv_map[input.sit_name], avg_metrics);
   StreamAndStdOut(context.report_out, report);
+  // The TT contents are those at the end of the last sample.
+  StreamAndStdOut(context.report_out,
+                  TTContentsReport(negamaxer.TTStats(kTTStatisticsSamples),
+                                   samples.back()));
   context.csv_out << CsvRow(input.sit_name, first_move, avg_metrics);
 }
 
+// One row per iterative-deepening depth and one column per run, with the time
+// in ms until the depth was completed, or "-" if it was not completed.
+std::string TimeToDepthTable(const std::vector<std::string>& run_names,
+                             const std::vector<BenchmarkMetrics>& runs) {
+  StrTable table;
+  table.AddToNewRow("Depth");
+  table.AddToLastRow(run_names);
+  long long max_depth = 0;
+  for (const BenchmarkMetrics& m : runs) {
+    max_depth = std::max(max_depth, m.max_completed_depth);
+  }
+  for (int depth = 1; depth <= max_depth; ++depth) {
+    table.AddToNewRow(depth);
+    for (const BenchmarkMetrics& m : runs) {
+      if (depth <= m.max_completed_depth)
+        table.AddToLastRow(m.completed_depth_millis[depth]);
+      else
+        table.AddToLastRow("-");
+    }
+  }
+  std::ostringstream sout;
+  sout << "Time to depth (ms):\n";
+  table.Print(sout, 2);
+  return sout.str();
+}
+
+// Same as `TimeToDepthTable`, but with the speedup of each run over the first
+// one (time of the first run divided by time of the run) to reach each depth.
+std::string TimeToDepthSpeedupTable(const std::vector<std::string>& run_names,
+                                    const std::vector<BenchmarkMetrics>& runs) {
+  StrTable table;
+  table.AddToNewRow("Depth");
+  table.AddToLastRow(run_names);
+  long long max_depth = 0;
+  for (const BenchmarkMetrics& m : runs) {
+    max_depth = std::max(max_depth, m.max_completed_depth);
+  }
+  const BenchmarkMetrics& base = runs[0];
+  for (int depth = 1; depth <= max_depth; ++depth) {
+    table.AddToNewRow(depth);
+    for (const BenchmarkMetrics& m : runs) {
+      if (depth <= base.max_completed_depth && depth <= m.max_completed_depth) {
+        // Depths completed in less than a millisecond count as 1 ms.
+        double speedup =
+            static_cast<double>(
+                std::max(base.completed_depth_millis[depth], 1LL)) /
+            std::max(m.completed_depth_millis[depth], 1LL);
+        table.AddToLastRow(speedup, 2);
+      } else {
+        table.AddToLastRow("-");
+      }
+    }
+  }
+  std::ostringstream sout;
+  sout << "Time to depth speedup over " << run_names[0] << ":\n";
+  table.Print(sout, 2);
+  return sout.str();
+}
+
+// Runs the AI on a situation with each number of threads in
+// `kBenchmarkThreadCounts` (see `Negamax::SetNumThreads`). Reports the time to
+// reach each depth and the speedup over the first thread count.
+template <int R, int C>
+void BenchmarkThreadScaling(BenchmarkContext& context,
+                            const BenchmarkSituationInput& input) {
+  Situation<R, C> sit = ParseSituationOrCrash<R, C>(input.standard_notation);
+  StreamAndStdOut(context.report_out,
+                  "Situation: " + input.sit_name + " (Lazy SMP threads)");
+  std::vector<std::string> run_names;
+  std::vector<BenchmarkMetrics> runs;
+  Negamax<R, C> negamaxer;
+  for (int num_threads : kBenchmarkThreadCounts) {
+    negamaxer.ClearTT();
+    negamaxer.SetNumThreads(num_threads);
+    auto move_metrics = GetMoveWithMetrics<R, C>(negamaxer, sit);
+    run_names.push_back(std::to_string(num_threads) + "T");
+    runs.push_back(move_metrics.second);
+    StreamAndStdOut(context.report_out,
+                    "Chosen move with " + std::to_string(num_threads) +
+                        " threads: " +
+                        sit.MoveToStandardNotation(move_metrics.first));
+  }
+  StreamAndStdOut(context.report_out, TimeToDepthTable(run_names, runs));
+  StreamAndStdOut(context.report_out, TimeToDepthSpeedupTable(run_names, runs));
+}
+
+// Runs the AI up to a fixed depth with the sequential search and with YBWC at
+// each thread count. Reports the wall-clock speedup and the node efficiency,
+// the ratio between the nodes visited by the sequential search and by YBWC,
+// which also visits the nodes that a sequential search would prune.
+template <int R, int C>
+void BenchmarkYBWC(BenchmarkContext& context,
+                   const BenchmarkSituationInput& input, int depth) {
+  Situation<R, C> sit = ParseSituationOrCrash<R, C>(input.standard_notation);
+  StreamAndStdOut(context.report_out, "Situation: " + input.sit_name +
+                                          " (YBWC at depth " +
+                                          std::to_string(depth) + ")");
+  StrTable table;
+  table.AddToNewRow({"Search", "Time (ms)", "Speedup", "Nodes",
+                     "Node efficiency", "Move"});
+  long long serial_ms = 0, serial_nodes = 0;
+  Negamax<R, C> negamaxer;
+  for (int num_threads : kBenchmarkThreadCounts) {
+    negamaxer.ClearTT();
+    negamaxer.SetNumThreads(num_threads, ParallelMode::kYBWC);
+    auto move_metrics = GetMoveWithMetrics<R, C>(negamaxer, sit, depth);
+    const BenchmarkMetrics& m = move_metrics.second;
+    // Runs faster than a millisecond count as 1 ms.
+    const long long ms = std::max(m.wall_clock_time_ms, 1LL);
+    const long long nodes = m.TotalExits();
+    if (num_threads == 1) {
+      serial_ms = ms;
+      serial_nodes = nodes;
+      table.AddToNewRow("Sequential");
+    } else {
+      table.AddToNewRow("YBWC " + std::to_string(num_threads) + "T");
+    }
+    table.AddToLastRow(ms);
+    table.AddToLastRow(static_cast<double>(serial_ms) / ms, 2);
+    table.AddToLastRow(nodes);
+    table.AddToLastRow(static_cast<double>(serial_nodes) / nodes, 2);
+    table.AddToLastRow(sit.MoveToStandardNotation(move_metrics.first));
+  }
+  std::ostringstream sout;
+  table.Print(sout, 2);
+  StreamAndStdOut(context.report_out, sout.str());
+}
+
+// Runs the AI on a situation with late move reductions and futility pruning
+// each disabled or enabled (see `Negamax::SetLateMoveReductions` and
+// `Negamax::SetFutilityPruning`). Reports the depth reached in
+// `kBenchmarksearchTimeMillis` and the time to reach each depth.
+template <int R, int C>
+void BenchmarkPruning(BenchmarkContext& context,
+                      const BenchmarkSituationInput& input) {
+  Situation<R, C> sit = ParseSituationOrCrash<R, C>(input.standard_notation);
+  StreamAndStdOut(context.report_out,
+                  "Situation: " + input.sit_name + " (LMR and futility)");
+  StrTable table;
+  table.AddToNewRow({"Search", "Depth reached", "Time (ms)", "Nodes",
+                     "LMR re-searches", "Futility prunes", "Move"});
+  const std::vector<std::string> run_names = {"None", "LMR", "Futility",
+                                              "Both"};
+  std::vector<BenchmarkMetrics> runs;
+  for (int i = 0; i < 4; ++i) {
+    Negamax<R, C> negamaxer;
+    negamaxer.SetLateMoveReductions(i == 1 || i == 3);
+    negamaxer.SetFutilityPruning(i == 2 || i == 3);
+    auto move_metrics = GetMoveWithMetrics<R, C>(negamaxer, sit);
+    const BenchmarkMetrics& m = move_metrics.second;
+    table.AddToNewRow(run_names[i]);
+    table.AddToLastRow(m.max_completed_depth);
+    table.AddToLastRow(m.wall_clock_time_ms);
+    table.AddToLastRow(m.TotalExits());
+    table.AddToLastRow(m.TotalLMRResearches());
+    table.AddToLastRow(m.TotalFutilityPrunes());
+    table.AddToLastRow(sit.MoveToStandardNotation(move_metrics.first));
+    runs.push_back(m);
+  }
+  std::ostringstream sout;
+  table.Print(sout, 2);
+  StreamAndStdOut(context.report_out, sout.str());
+  StreamAndStdOut(context.report_out, TimeToDepthTable(run_names, runs));
+}
+
+// Runs the AI on a situation with null-move pruning disabled and enabled (see
+// `Negamax::SetNullMovePruning`). Reports the depth reached in
+// `kBenchmarksearchTimeMillis` and the time to reach each depth.
+template <int R, int C>
+void BenchmarkNullMove(BenchmarkContext& context,
+                       const BenchmarkSituationInput& input) {
+  Situation<R, C> sit = ParseSituationOrCrash<R, C>(input.standard_notation);
+  StreamAndStdOut(context.report_out,
+                  "Situation: " + input.sit_name + " (null-move pruning)");
+  StrTable table;
+  table.AddToNewRow({"Search", "Depth reached", "Time (ms)", "Nodes",
+                     "Null-move searches", "Null-move cutoffs", "Move"});
+  const std::vector<std::string> run_names = {"Without", "With"};
+  std::vector<BenchmarkMetrics> runs;
+  for (int i = 0; i < 2; ++i) {
+    Negamax<R, C> negamaxer;
+    negamaxer.SetNullMovePruning(i == 1);
+    auto move_metrics = GetMoveWithMetrics<R, C>(negamaxer, sit);
+    const BenchmarkMetrics& m = move_metrics.second;
+    table.AddToNewRow(run_names[i]);
+    table.AddToLastRow(m.max_completed_depth);
+    table.AddToLastRow(m.wall_clock_time_ms);
+    table.AddToLastRow(m.TotalExits());
+    table.AddToLastRow(m.null_move_searches);
+    table.AddToLastRow(m.null_move_cutoffs);
+    table.AddToLastRow(sit.MoveToStandardNotation(move_metrics.first));
+    runs.push_back(m);
+  }
+  std::ostringstream sout;
+  table.Print(sout, 2);
+  StreamAndStdOut(context.report_out, sout.str());
+  StreamAndStdOut(context.report_out, TimeToDepthTable(run_names, runs));
+}
+
+// Runs the AI on a situation with each root algorithm (see
+// `Negamax::SetRootAlgorithm`). Reports the depth reached in
+// `kBenchmarksearchTimeMillis` and the time to reach each depth.
+template <int R, int C>
+void BenchmarkRootAlgorithms(BenchmarkContext& context,
+                             const BenchmarkSituationInput& input) {
+  Situation<R, C> sit = ParseSituationOrCrash<R, C>(input.standard_notation);
+  StreamAndStdOut(context.report_out,
+                  "Situation: " + input.sit_name + " (root algorithms)");
+  StrTable table;
+  table.AddToNewRow({"Search", "Depth reached", "Time (ms)", "Nodes",
+                     "Root searches", "Move"});
+  const std::vector<std::string> run_names = {"Alpha-beta", "MTD(f)"};
+  const std::vector<RootAlgorithm> algorithms = {RootAlgorithm::kAlphaBeta,
+                                                 RootAlgorithm::kMTDf};
+  std::vector<BenchmarkMetrics> runs;
+  for (std::size_t i = 0; i < algorithms.size(); ++i) {
+    Negamax<R, C> negamaxer;
+    negamaxer.SetRootAlgorithm(algorithms[i]);
+    auto move_metrics = GetMoveWithMetrics<R, C>(negamaxer, sit);
+    const BenchmarkMetrics& m = move_metrics.second;
+    table.AddToNewRow(run_names[i]);
+    table.AddToLastRow(m.max_completed_depth);
+    table.AddToLastRow(m.wall_clock_time_ms);
+    table.AddToLastRow(m.TotalExits());
+    // Alpha-beta searches the root once per depth, plus the re-searches.
+    table.AddToLastRow(algorithms[i] == RootAlgorithm::kMTDf
+                           ? m.mtdf_searches
+                           : m.max_completed_depth + m.aspiration_researches);
+    table.AddToLastRow(sit.MoveToStandardNotation(move_metrics.first));
+    runs.push_back(m);
+  }
+  std::ostringstream sout;
+  table.Print(sout, 2);
+  StreamAndStdOut(context.report_out, sout.str());
+  StreamAndStdOut(context.report_out, TimeToDepthTable(run_names, runs));
+}
+
+// Runs a single-PV search and a multi-PV search of the best `num_moves` moves
+// (see `Negamax::GetTopMoves`) on a situation, both to depth `depth`. Reports
+// the cost of multi-PV relative to single-PV and the ranked moves.
+template <int R, int C>
+void BenchmarkMultiPV(BenchmarkContext& context,
+                      const BenchmarkSituationInput& input, int depth,
+                      int num_moves = 3) {
+  Situation<R, C> sit = ParseSituationOrCrash<R, C>(input.standard_notation);
+  StreamAndStdOut(context.report_out, "Situation: " + input.sit_name +
+                                          " (multi-PV at depth " +
+                                          std::to_string(depth) + ")");
+  BenchmarkMetrics single_pv, multi_pv;
+  std::vector<RankedMove> top_moves;
+  {
+    Negamax<R, C> negamaxer;
+    single_pv = GetMoveWithMetrics<R, C>(negamaxer, sit, depth).second;
+  }
+  {
+    Negamax<R, C> negamaxer;
+    global_metrics = {};
+    auto start = std::chrono::high_resolution_clock::now();
+    top_moves = negamaxer.GetTopMoves(sit, num_moves,
+                                      kBenchmarksearchTimeMillis, depth);
+    multi_pv = global_metrics;
+    multi_pv.wall_clock_time_ms = MillisSince(start);
+  }
+  StrTable table;
+  table.AddToNewRow({"Search", "Depth reached", "Time (ms)", "Nodes",
+                     "Relative time", "Relative nodes"});
+  const std::vector<std::string> run_names = {
+      "Single-PV", "Multi-PV (" + std::to_string(num_moves) + ")"};
+  const std::vector<BenchmarkMetrics> runs = {single_pv, multi_pv};
+  for (std::size_t i = 0; i < runs.size(); ++i) {
+    const BenchmarkMetrics& m = runs[i];
+    table.AddToNewRow(run_names[i]);
+    table.AddToLastRow(m.max_completed_depth);
+    table.AddToLastRow(m.wall_clock_time_ms);
+    table.AddToLastRow(m.TotalExits());
+    table.AddToLastRow(static_cast<double>(m.wall_clock_time_ms) /
+                       std::max<long long>(single_pv.wall_clock_time_ms, 1),
+                       2);
+    table.AddToLastRow(static_cast<double>(m.TotalExits()) /
+                       std::max<long long>(single_pv.TotalExits(), 1),
+                       2);
+  }
+  std::ostringstream sout;
+  table.Print(sout, 2);
+  StrTable ranking;
+  ranking.AddToNewRow({"Rank", "Move", "Eval", "Principal variation"});
+  for (std::size_t i = 0; i < top_moves.size(); ++i) {
+    ranking.AddToNewRow(static_cast<long long>(i + 1));
+    ranking.AddToLastRow(sit.MoveToStandardNotation(top_moves[i].move));
+    ranking.AddToLastRow(top_moves[i].eval);
+    std::string pv;
+    Situation<R, C> pv_sit = sit;
+    for (const Move& move : top_moves[i].pv) {
+      if (!pv.empty()) pv += ", ";
+      pv += pv_sit.MoveToStandardNotation(move);
+      pv_sit.ApplyMove(move);
+    }
+    ranking.AddToLastRow(pv);
+  }
+  ranking.Print(sout, 2);
+  StreamAndStdOut(context.report_out, sout.str());
+}
+
+// Runs the AI on a situation with an empty TT, saves the TT to a snapshot
+// file, and runs it again in a new AI that loads the snapshot, as a restarted
+// process would. Reports the time to reach each depth in both cases.
+template <int R, int C>
+void BenchmarkWarmStart(BenchmarkContext& context,
+                        const BenchmarkSituationInput& input,
+                        const std::string& snapshot_file) {
+  Situation<R, C> sit = ParseSituationOrCrash<R, C>(input.standard_notation);
+  StreamAndStdOut(context.report_out,
+                  "Situation: " + input.sit_name + " (TT warm start)");
+  BenchmarkMetrics cold, warm;
+  {
+    Negamax<R, C> negamaxer;
+    cold = GetMoveWithMetrics<R, C>(negamaxer, sit).second;
+    if (!negamaxer.SaveTT(snapshot_file)) return;
+  }
+  {
+    Negamax<R, C> negamaxer;
+    if (!negamaxer.LoadTT(snapshot_file)) return;
+    warm = GetMoveWithMetrics<R, C>(negamaxer, sit).second;
+  }
+  std::remove(snapshot_file.c_str());
+  StreamAndStdOut(context.report_out,
+                  TimeToDepthTable({"Cold", "Warm"}, {cold, warm}));
+}
+
+// Solves a situation with the proof-number search of `Negamax::Solve`, with a
+// budget of `max_nodes` expanded nodes, and reports the outcome and its cost.
+template <int R, int C>
+void BenchmarkSolver(BenchmarkContext& context,
+                     const BenchmarkSituationInput& input,
+                     long long max_nodes = kSolveMaxNodes) {
+  Situation<R, C> sit = ParseSituationOrCrash<R, C>(input.standard_notation);
+  StreamAndStdOut(context.report_out,
+                  "Situation: " + input.sit_name + " (df-pn solver)");
+  Negamax<R, C> negamaxer;
+  auto start = std::chrono::high_resolution_clock::now();
+  const SolveResult result = negamaxer.Solve(sit, max_nodes);
+  const int millis = MillisSince(start);
+  StrTable table;
+  table.AddToNewRow({"Outcome", "Move", "Nodes", "Time (ms)"});
+  table.AddToNewRow(SolveOutcomeName(result.outcome));
+  table.AddToLastRow(result.outcome == SolveOutcome::kWin ||
+                             result.outcome == SolveOutcome::kDraw
+                         ? sit.MoveToStandardNotation(result.move)
+                         : "-");
+  table.AddToLastRow(result.num_nodes);
+  table.AddToLastRow(millis);
+  std::ostringstream sout;
+  table.Print(sout, 2);
+  StreamAndStdOut(context.report_out, sout.str());
+}
+
+// Plays `Mcts` against `Negamax` from the starting situation, once with each
+// engine as P0, with `kBenchmarkMatchMillis` per move, and reports the winners
+// and the playouts of MCTS per move. Games that reach `kBenchmarkMatchMaxPlies`
+// plies are unfinished.
+template <int R, int C>
+void BenchmarkEngineMatch(BenchmarkContext& context) {
+  StreamAndStdOut(context.report_out,
+                  "Match: MCTS vs Negamax (" +
+                      std::to_string(kBenchmarkMatchMillis) + " ms per move)");
+  StrTable table;
+  table.AddToNewRow({"MCTS plays", "Winner", "Plies", "Playouts per move"});
+  for (int mcts_player : {0, 1}) {
+    Mcts<R, C> mcts;
+    Negamax<R, C> negamaxer;
+    Situation<R, C> sit = StartingSituation<R, C>();
+    int num_plies = 0;
+    long long num_playouts = 0;
+    for (; !sit.IsGameOver() && num_plies < kBenchmarkMatchMaxPlies;
+         ++num_plies) {
+      Move move;
+      if (sit.turn == mcts_player) {
+        global_metrics = {};
+        move = mcts.GetMove(sit, kBenchmarkMatchMillis);
+        num_playouts += global_metrics.mcts_playouts;
+      } else {
+        move = negamaxer.GetMove(sit, kBenchmarkMatchMillis);
+      }
+      sit.ApplyMove(move);
+    }
+    std::string winner = "unfinished";
+    if (sit.IsGameOver()) {
+      winner = sit.Winner() == 2                ? "draw"
+               : sit.Winner() == mcts_player ? "MCTS"
+                                             : "Negamax";
+    }
+    table.AddToNewRow("P" + std::to_string(mcts_player));
+    table.AddToLastRow(winner);
+    table.AddToLastRow(num_plies);
+    // MCTS plays every other ply, starting at ply `mcts_player`.
+    table.AddToLastRow(num_playouts /
+                       std::max((num_plies + 1 - mcts_player) / 2, 1));
+  }
+  std::ostringstream sout;
+  table.Print(sout, 2);
+  StreamAndStdOut(context.report_out, sout.str());
+}
+
+// Compares the speed of the distance eval of `Negamax::LeafEval`, which runs
+// two BFS, with the parts of the NNUE evaluation (see nnue.h), with random
+// weights: the output layer, the incremental update of the accumulator for a
+// move and its undo, and the computation of the accumulator from scratch.
+template <int R, int C>
+void BenchmarkNnue(BenchmarkContext& context,
+                   const BenchmarkSituationInput& input) {
+  constexpr int kIterations = 1000000;
+  Situation<R, C> sit = ParseSituationOrCrash<R, C>(input.standard_notation);
+  StreamAndStdOut(context.report_out,
+                  "Situation: " + input.sit_name + " (NNUE evaluation)");
+  const std::unique_ptr<NnueWeights<R, C>> weights =
+      NnueWeights<R, C>::Random(1);
+  NnueAccumulator acc;
+  weights->Refresh(sit, acc);
+  const Move move = sit.AllLegalMoves().back();
+  // Each operation adds to `checksum` and depends on the iteration, so that
+  // the compiler cannot hoist it out of the loop.
+  long long checksum = 0;
+  StrTable table;
+  table.AddToNewRow({"Operation", "Per second", "ns each"});
+  auto add_row = [&](const std::string& name, auto operation) {
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < kIterations; ++i) checksum += operation(i);
+    const double ns = std::chrono::duration<double, std::nano>(
+                          std::chrono::high_resolution_clock::now() - start)
+                          .count() /
+                      kIterations;
+    table.AddToNewRow(name);
+    table.AddToLastRow(static_cast<long long>(1e9 / ns));
+    table.AddToLastRow(ns, 1);
+  };
+  add_row("Distance eval (LeafEval)", [&](int) {
+    return sit.G.Distance(sit.tokens[1], Goals(R, C)[1]) -
+           sit.G.Distance(sit.tokens[0], Goals(R, C)[0]);
+  });
+  add_row("NNUE output layer (scalar)", [&](int i) {
+    acc.values[0] ^= i & 1;
+    return weights->EvaluateScalar(acc);
+  });
+#ifdef __AVX2__
+  add_row("NNUE output layer (AVX2)", [&](int i) {
+    acc.values[0] ^= i & 1;
+    return weights->EvaluateAvx2(acc);
+  });
+#endif
+  add_row("NNUE update for move + undo", [&](int) {
+    weights->UpdateForMove(sit, move, acc, false);
+    weights->UpdateForMove(sit, move, acc, true);
+    return acc.values[1];
+  });
+  add_row("NNUE accumulator from scratch", [&](int) {
+    weights->Refresh(sit, acc);
+    return acc.values[2];
+  });
+  std::ostringstream sout;
+  table.Print(sout, 2);
+  sout << "(checksum: " << checksum << ")";
+  StreamAndStdOut(context.report_out, sout.str());
+}
+
 void BenchmarkSituations(BenchmarkContext& context) {
   BenchmarkSituationInput input;
 
   StreamAndStdOut(context.report_out, DimensionsSettings<8, 8>());
   input = {"Empty-8x8", "", "c1"};
   BenchmarkSituation<8, 8>(context, input);
+  BenchmarkWarmStart<8, 8>(context, input,
+                           context.benchmark_dir + "warm_start_tt.bin");
+  BenchmarkThreadScaling<8, 8>(context, input);
+  BenchmarkNullMove<8, 8>(context, input);
+  BenchmarkRootAlgorithms<8, 8>(context, input);
+  BenchmarkMultiPV<8, 8>(context, input, 3);
 
   StreamAndStdOut(context.report_out, DimensionsSettings<10, 12>());
   input = {"Empty-10x12", "", "c1"};
   BenchmarkSituation<10, 12>(context, input);
+  BenchmarkYBWC<10, 12>(context, input, 2);
+  BenchmarkRootAlgorithms<10, 12>(context, input);
   input = {"Trident-opening", "1. b2 2. b3v c2>", "c3"};
   BenchmarkSituation<10, 12>(context, input);
+  BenchmarkEngineMatch<10, 12>(context);
+  BenchmarkNnue<10, 12>(context, input);
 
   StreamAndStdOut(context.report_out, DimensionsSettings<4, 4>());
   input = {"Empty-4x4", "", "b2"};
   BenchmarkSituation<4, 4>(context, input);
+  BenchmarkRootAlgorithms<4, 4>(context, input);
+  BenchmarkMultiPV<4, 4>(context, input, 6);
 
   StreamAndStdOut(context.report_out, DimensionsSettings<3, 7>());
   input = {"Puzzle2",
            "1. c1 2. e1 3. a1> a2> 4. f1> f2> 5. c1v d1v 6. c2v e1v 7. d2v e2v",
            "c3> e1>"};
   BenchmarkSituation<3, 7>(context, input);
+  BenchmarkSolver<3, 7>(context, input);
   input = {"Puzzle9",
            "1. b2 2. f2 3. d2 4. d2 5. f2 6. b2 7. a2> b2v 8. f2v f2>",
            "a1v c2v"};
   BenchmarkSituation<3, 7>(context, input);
+  BenchmarkPruning<3, 7>(context, input);
+  BenchmarkNullMove<3, 7>(context, input);
+  BenchmarkRootAlgorithms<3, 7>(context, input);
+  BenchmarkMultiPV<3, 7>(context, input, 6);
+  BenchmarkSolver<3, 7>(context, input, kBenchmarkSolveMaxNodes);
 
   StreamAndStdOut(context.report_out, DimensionsSettings<5, 5>());
   input = {"Puzzle5",
            "1. d2> d3> 2. d4v d4> 3. b4v c4v 4. a3> a4> 5. a2> b1v 6. b2> b3>",
            "c1> e3v"};
   BenchmarkSituation<5, 5>(context, input);
+  BenchmarkRootAlgorithms<5, 5>(context, input);
+  BenchmarkSolver<5, 5>(context, input);
 
   StreamAndStdOut(context.report_out, DimensionsSettings<4, 5>());
   input = {"Puzzle6",
@@ -552,6 +1335,8 @@ void BenchmarkSituations(BenchmarkContext& context) {
            "8. a2> c2>",
            "a3> c1>"};
   BenchmarkSituation<4, 5>(context, input);
+  BenchmarkRootAlgorithms<4, 5>(context, input);
+  BenchmarkSolver<4, 5>(context, input);
 
   StreamAndStdOut(context.report_out, DimensionsSettings<6, 9>());
   input = {"Tim-puzzle",
@@ -559,6 +1344,12 @@ void BenchmarkSituations(BenchmarkContext& context) {
            "7. f1> f6> 8. c1> c2> 9. a2 f2> 10. h2> h3>",
            "a5v b5v"};
   BenchmarkSituation<6, 9>(context, input);
+  BenchmarkYBWC<6, 9>(context, input, 3);
+  BenchmarkPruning<6, 9>(context, input);
+  BenchmarkNullMove<6, 9>(context, input);
+  BenchmarkRootAlgorithms<6, 9>(context, input);
+  BenchmarkMultiPV<6, 9>(context, input, 4);
+  BenchmarkSolver<6, 9>(context, input, kBenchmarkSolveMaxNodes);
 }
 
 }  // namespace benchmark_internal
@@ -605,7 +1396,8 @@ void RunBenchmark(const std::string& description,
   StreamAndStdOut(report_out, BenchmarkSettings(description, timestamp));
 
   std::ostringstream situations_out;
-  BenchmarkContext context{situations_out, csv_out, prev_csv_map};
+  BenchmarkContext context{benchmark_dir, situations_out, csv_out,
+                           prev_csv_map};
   BenchmarkSituations(context);
 
   if (!prev_csv_file.empty()) {
@@ -46,11 +46,29 @@ enum TTWrites {
   // The sitaution was not in the TT and it is added while kicking another
   // situation out.
   REPLACE_WRITE,
-  // The situation is not stored in the TT.
+  // The situation is not stored in the TT, either because it is not a
+  // recursive visit or because the replacement policy keeps the existing entry.
   NO_WRITE,
 };
 constexpr int kNumTTWriteTypes = 4;
 
+// The move that causes a beta cutoff, by the order in which it is tried.
+enum CutoffMoves {
+  // The move in the TT entry, tried first.
+  TT_MOVE_CUTOFF,
+  // The double walk towards the goal, tried second.
+  DOUBLE_WALK_CUTOFF,
+  // The first, second, and third moves from `OrderedMoves`.
+  FIRST_MOVE_CUTOFF,
+  SECOND_MOVE_CUTOFF,
+  THIRD_MOVE_CUTOFF,
+  // The 4th to 8th moves from `OrderedMoves`.
+  EARLY_MOVE_CUTOFF,
+  // Any later move from `OrderedMoves`.
+  LATE_MOVE_CUTOFF,
+};
+constexpr int kNumCutoffMoveTypes = 7;
+
 struct BenchmarkMetrics {
   long long wall_clock_time_ms = 0;
 
@@ -87,6 +105,19 @@ struct BenchmarkMetrics {
   std::array<long long, kMaxDepth + 1> tt_improvement_reads;
   std::array<long long, kMaxDepth + 1> tt_useless_reads;
 
+  // Every time the TT is checked for a situation.
+  std::array<long long, kMaxDepth + 1> tt_probes;
+  // Reads that find the situation in the TT, whether or not the entry is deep
+  // enough to be used.
+  std::array<long long, kMaxDepth + 1> tt_found_reads;
+  // Reads that do not find the situation because its slot holds a different
+  // one. They are a subset of MISS_READ.
+  std::array<long long, kMaxDepth + 1> tt_collision_reads;
+  // Reads that find the situation in an entry written during the search of its
+  // mirror image. They are a subset of the found reads. See
+  // `kMirrorCanonicalization`.
+  std::array<long long, kMaxDepth + 1> tt_mirrored_reads;
+
   long long TTReadsAtDepthOfType(int depth, int read_type) const {
     switch (read_type) {
       case EXACT_READ:
@@ -121,6 +152,33 @@ struct BenchmarkMetrics {
     return res;
   }
 
+  long long TotalTTProbes() const {
+    long long res = 0;
+    for (int depth = 0; depth <= kMaxDepth; ++depth) res += tt_probes[depth];
+    return res;
+  }
+
+  long long TotalTTFoundReads() const {
+    long long res = 0;
+    for (int depth = 0; depth <= kMaxDepth; ++depth)
+      res += tt_found_reads[depth];
+    return res;
+  }
+
+  long long TotalTTCollisionReads() const {
+    long long res = 0;
+    for (int depth = 0; depth <= kMaxDepth; ++depth)
+      res += tt_collision_reads[depth];
+    return res;
+  }
+
+  long long TotalTTMirroredReads() const {
+    long long res = 0;
+    for (int depth = 0; depth <= kMaxDepth; ++depth)
+      res += tt_mirrored_reads[depth];
+    return res;
+  }
+
   long long TotalTTReads() const {
     long long res = 0;
     for (int depth = 0; depth <= kMaxDepth; ++depth)
@@ -131,18 +189,21 @@ struct BenchmarkMetrics {
   // We only need to store these two types of writes. The others can be derived.
   std::array<long long, kMaxDepth + 1> tt_add_writes;
   std::array<long long, kMaxDepth + 1> tt_replace_writes;
+  // Writes skipped by the replacement policy. They count as NO_WRITE.
+  std::array<long long, kMaxDepth + 1> tt_rejected_writes;
 
   long long TTWritesAtDepthOfType(int depth, int read_type) const {
     switch (read_type) {
       case UPDATE_WRITE:
         return num_exits[depth][REC_EVAL_EXIT] - tt_add_writes[depth] -
-               tt_replace_writes[depth];
+               tt_replace_writes[depth] - tt_rejected_writes[depth];
       case ADD_WRITE:
         return tt_add_writes[depth];
       case REPLACE_WRITE:
         return tt_replace_writes[depth];
       case NO_WRITE:
-        return ExitsAtDepth(depth) - num_exits[depth][REC_EVAL_EXIT];
+        return ExitsAtDepth(depth) - num_exits[depth][REC_EVAL_EXIT] +
+               tt_rejected_writes[depth];
       default:
         return -1;
     }
@@ -169,6 +230,11 @@ struct BenchmarkMetrics {
     return res;
   }
 
+  // Time in ms since the start of the search until each iterative-deepening
+  // depth was completed. Only depths up to `max_completed_depth` are valid.
+  std::array<long long, kMaxDepth + 1> completed_depth_millis;
+  long long max_completed_depth = 0;
+
   // A child is "generated" if it is created and stored in memory. Children that
   // are generated and not visited are called "pruned".
   std::array<long long, kMaxDepth + 1> generated_children;
@@ -202,10 +268,160 @@ struct BenchmarkMetrics {
       res += PrunedChildrenAtDepth(depth);
     return res;
   }
+
+  // Children whose null-window search showed that they improve alpha, so they
+  // were searched again with the full window. The depth is the parent's.
+  std::array<long long, kMaxDepth + 1> pvs_researches;
+  // Root searches repeated because the eval fell outside the aspiration
+  // window.
+  long long aspiration_researches = 0;
+  // Null-window root searches run by the MTD(f) root algorithm.
+  long long mtdf_searches = 0;
+  // Nodes solved exactly by the race solver. They are also counted as
+  // game-over exits.
+  long long race_solves = 0;
+  // Children searched at a reduced depth by late move reductions, and those
+  // among them searched again at full depth. The depth is the parent's.
+  std::array<long long, kMaxDepth + 1> lmr_reductions;
+  std::array<long long, kMaxDepth + 1> lmr_researches;
+  // Nodes that failed low by futility pruning (depth 1) or razoring (depth 2).
+  std::array<long long, kMaxDepth + 1> futility_prunes;
+  // Nodes searched by the quiescence search below depth 0, and nodes where it
+  // found that the player to move reaches the goal with its next move.
+  long long quiescence_nodes = 0;
+  long long quiescence_wins = 0;
+  // Playouts run by `Mcts`, which does not use the other metrics except for
+  // `graph_primitives`.
+  long long mcts_playouts = 0;
+  // Lookups in the evaluation cache, those that found the distances, and the
+  // graph primitives that the hits saved. See `EvalCache`.
+  long long eval_cache_probes = 0;
+  long long eval_cache_hits = 0;
+  long long eval_cache_saved_primitives = 0;
+  // TT entries of children read by enhanced transposition cutoffs, and the
+  // nodes that they cut off. See `Negamax::EnhancedTranspositionCutoff`.
+  long long etc_probes = 0;
+  long long etc_cutoffs = 0;
+  // Searches run by internal iterative deepening, and those whose best move
+  // caused a beta cutoff when it was searched first at full depth. See
+  // `Negamax::kIIDMinDepth`.
+  long long iid_searches = 0;
+  long long iid_move_cutoffs = 0;
+  // Searches with the turn passed by null-move pruning, and the nodes that
+  // they cut off. See `Negamax::kNullMoveMinDepth`.
+  long long null_move_searches = 0;
+  long long null_move_cutoffs = 0;
+
+  // Beta cutoffs in the search function, by cutoff move.
+  std::array<std::array<long long, kNumCutoffMoveTypes>, kMaxDepth + 1>
+      cutoff_moves;
+  // Sum of the indices in `OrderedMoves` of the cutoff moves taken from it.
+  std::array<long long, kMaxDepth + 1> cutoff_index_sum;
+
+  long long CutoffsAtDepth(int depth) const {
+    long long res = 0;
+    for (int type = 0; type < kNumCutoffMoveTypes; ++type)
+      res += cutoff_moves[depth][type];
+    return res;
+  }
+
+  long long CutoffsOfType(int type) const {
+    long long res = 0;
+    for (int depth = 0; depth <= kMaxDepth; ++depth)
+      res += cutoff_moves[depth][type];
+    return res;
+  }
+
+  long long TotalCutoffs() const {
+    long long res = 0;
+    for (int depth = 0; depth <= kMaxDepth; ++depth)
+      res += CutoffsAtDepth(depth);
+    return res;
+  }
+
+  long long TotalCutoffIndexSum() const {
+    long long res = 0;
+    for (int depth = 0; depth <= kMaxDepth; ++depth)
+      res += cutoff_index_sum[depth];
+    return res;
+  }
+
+  long long TotalPVSResearches() const {
+    long long res = 0;
+    for (int depth = 0; depth <= kMaxDepth; ++depth)
+      res += pvs_researches[depth];
+    return res;
+  }
+
+  long long TotalLMRReductions() const {
+    long long res = 0;
+    for (int depth = 0; depth <= kMaxDepth; ++depth)
+      res += lmr_reductions[depth];
+    return res;
+  }
+
+  long long TotalLMRResearches() const {
+    long long res = 0;
+    for (int depth = 0; depth <= kMaxDepth; ++depth)
+      res += lmr_researches[depth];
+    return res;
+  }
+
+  long long TotalFutilityPrunes() const {
+    long long res = 0;
+    for (int depth = 0; depth <= kMaxDepth; ++depth)
+      res += futility_prunes[depth];
+    return res;
+  }
+
+  // Adds the counters of `other`, e.g., those of another thread of the same
+  // search. Times and depths are not added.
+  void Add(const BenchmarkMetrics& other) {
+    graph_primitives += other.graph_primitives;
+    for (int depth = 0; depth <= kMaxDepth; ++depth) {
+      for (int exit_type = 0; exit_type < kNumExitTypes; ++exit_type)
+        num_exits[depth][exit_type] += other.num_exits[depth][exit_type];
+      tt_improvement_reads[depth] += other.tt_improvement_reads[depth];
+      tt_useless_reads[depth] += other.tt_useless_reads[depth];
+      tt_probes[depth] += other.tt_probes[depth];
+      tt_found_reads[depth] += other.tt_found_reads[depth];
+      tt_collision_reads[depth] += other.tt_collision_reads[depth];
+      tt_mirrored_reads[depth] += other.tt_mirrored_reads[depth];
+      tt_add_writes[depth] += other.tt_add_writes[depth];
+      tt_replace_writes[depth] += other.tt_replace_writes[depth];
+      tt_rejected_writes[depth] += other.tt_rejected_writes[depth];
+      generated_children[depth] += other.generated_children[depth];
+      pvs_researches[depth] += other.pvs_researches[depth];
+      lmr_reductions[depth] += other.lmr_reductions[depth];
+      lmr_researches[depth] += other.lmr_researches[depth];
+      futility_prunes[depth] += other.futility_prunes[depth];
+      for (int type = 0; type < kNumCutoffMoveTypes; ++type)
+        cutoff_moves[depth][type] += other.cutoff_moves[depth][type];
+      cutoff_index_sum[depth] += other.cutoff_index_sum[depth];
+    }
+    aspiration_researches += other.aspiration_researches;
+    mtdf_searches += other.mtdf_searches;
+    race_solves += other.race_solves;
+    quiescence_nodes += other.quiescence_nodes;
+    quiescence_wins += other.quiescence_wins;
+    mcts_playouts += other.mcts_playouts;
+    eval_cache_probes += other.eval_cache_probes;
+    eval_cache_hits += other.eval_cache_hits;
+    eval_cache_saved_primitives += other.eval_cache_saved_primitives;
+    etc_probes += other.etc_probes;
+    etc_cutoffs += other.etc_cutoffs;
+    iid_searches += other.iid_searches;
+    iid_move_cutoffs += other.iid_move_cutoffs;
+    null_move_searches += other.null_move_searches;
+    null_move_cutoffs += other.null_move_cutoffs;
+  }
 };
 
-// Global object updated during the Negamax search using the macros below.
-BenchmarkMetrics global_metrics;
+// Global object updated during the Negamax search using the macros below. Each
+// thread has its own, so with Lazy SMP the metrics are those of the thread
+// that calls `Negamax::GetMove`. With YBWC, the metrics of the pool threads
+// are added to it at the end of the search.
+thread_local BenchmarkMetrics global_metrics;
 
 #define METRIC_INC(metric)   \
   if (kBenchmark) {          \
@@ -217,6 +433,11 @@ BenchmarkMetrics global_metrics;
     global_metrics.metric += val; \
   }
 
+#define METRIC_SET(metric, val)  \
+  if (kBenchmark) {              \
+    global_metrics.metric = val; \
+  }
+
 }  // namespace wallwars
 
 #endif  // BENCHMARK_METRICS_H_
@@ -1,6 +1,9 @@
 #ifndef CONSTANTS_H_
 #define CONSTANTS_H_
 
+#include <array>
+#include <cstddef>
+
 namespace wallwars {
 
 // Search depth of the Negamax AI.
@@ -9,6 +12,20 @@ constexpr int kMaxDepth = 20;
 // Space allocated for the transposition table in mega bytes.
 constexpr int kTranspositionTableMB = 512;
 
+// Space allocated for the proof-number table of the solver in mega bytes, and
+// the default number of nodes that it expands before giving up. See
+// `Negamax::Solve`.
+constexpr int kProofNumberTableMB = 64;
+constexpr long long kSolveMaxNodes = 1000000;
+
+// Number of entries of the evaluation cache (8 bytes each), small enough to
+// stay in the CPU cache. See `EvalCache`.
+constexpr std::size_t kEvalCacheEntries = 1 << 16;
+
+// Whether a situation and its left-right mirror image (with the players
+// swapped) share a transposition table entry.
+constexpr bool kMirrorCanonicalization = true;
+
 constexpr int kInteractiveGameR = 8;
 constexpr int kInteractiveGameC = 8;
 constexpr int kInteractiveGameMillis = 20000;
@@ -18,6 +35,15 @@ constexpr bool kBenchmark = true;
 
 constexpr int kBenchmarkNumSamples = 2;
 constexpr int kBenchmarksearchTimeMillis = 10000;
+// Node budget of the solver in the benchmark for the situations that it does
+// not solve with `kSolveMaxNodes`, which would take minutes.
+constexpr long long kBenchmarkSolveMaxNodes = 100000;
+// Time per move and maximum length of the games between `Mcts` and `Negamax`
+// in the benchmark.
+constexpr int kBenchmarkMatchMillis = 300;
+constexpr int kBenchmarkMatchMaxPlies = 300;
+// Thread counts compared in the Lazy SMP benchmark.
+constexpr std::array<int, 5> kBenchmarkThreadCounts = {1, 2, 4, 8, 16};
 
 constexpr int kBrowserR = 7;
 constexpr int kBrowserC = 7;
@@ -0,0 +1,66 @@
+#ifndef EVAL_CACHE_H_
+#define EVAL_CACHE_H_
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "constants.h"
+
+namespace wallwars {
+
+// A small, lossy cache of the distances of the players to their goals, the
+// inputs of the static evaluation of `Negamax` (see `Negamax::GoalDistances`),
+// which otherwise cost two BFS at each leaf. The distances do not depend on
+// the player to move, so entries are keyed by the hash of a situation without
+// the turn. Unlike the TT, the cache is small enough to stay in the CPU cache,
+// and it is never cleared, since the distances of a situation never change.
+//
+// Each entry is a single 64-bit word, so threads can share the cache without
+// locks: one byte for each distance, which is below the number of nodes, at
+// most 128, and the rest of the key in the other 48 bits.
+// The location of an entry gives the low 16 bits of the key, so the whole key
+// is checked. An entry is replaced by any newer one for the same location.
+class EvalCache {
+ public:
+  EvalCache()
+      : entries_(std::make_unique<std::atomic<uint64_t>[]>(kEvalCacheEntries)) {
+  }
+
+  // Sets `goal_distances` to the distances of P0 and P1 for the situation
+  // with key `key`, if there is an entry for it. Returns whether there is.
+  bool Probe(uint64_t key, std::array<int, 2>& goal_distances) const {
+    const uint64_t entry =
+        entries_[Location(key)].load(std::memory_order_relaxed);
+    if (entry == 0 || ((entry ^ key) & kKeyMask) != 0) return false;
+    goal_distances = {static_cast<int>((entry >> 8) & 0xFF),
+                      static_cast<int>(entry & 0xFF)};
+    return true;
+  }
+
+  void Store(uint64_t key, const std::array<int, 2>& goal_distances) {
+    const uint64_t entry = (key & kKeyMask) |
+                           (static_cast<uint64_t>(goal_distances[0]) << 8) |
+                           static_cast<uint64_t>(goal_distances[1]);
+    entries_[Location(key)].store(entry, std::memory_order_relaxed);
+  }
+
+ private:
+  static_assert((kEvalCacheEntries & (kEvalCacheEntries - 1)) == 0,
+                "The number of entries must be a power of 2");
+  static_assert(kEvalCacheEntries >= (1 << 16),
+                "The location must give the 16 bits of the key that are not "
+                "stored");
+  static constexpr uint64_t kKeyMask = ~uint64_t{0xFFFF};
+
+  static std::size_t Location(uint64_t key) {
+    return key & (kEvalCacheEntries - 1);
+  }
+
+  std::unique_ptr<std::atomic<uint64_t>[]> entries_;
+};
+
+}  // namespace wallwars
+
+#endif  // EVAL_CACHE_H_
@@ -0,0 +1,123 @@
+#ifndef GAME_SESSION_H_
+#define GAME_SESSION_H_
+
+#include <string>
+#include <vector>
+
+#include "move.h"
+#include "negamax.h"
+#include "situation.h"
+#include "time_manager.h"
+
+namespace wallwars {
+
+// A game played with one AI that keeps its search state from move to move:
+// the TT and the move-ordering heuristics. This also saves allocating a new TT
+// for every move. Moves are played one at a time with `PlayMove` instead of
+// replaying the whole game for every move. Iterative deepening can also resume
+// from the depth already searched for the new situation with
+// `AI().SetResumeFromTT(true)`, but that is off by default since it does not
+// pay off in benchmarks: the shallow iterations it skips are cheap and order
+// the moves of the deeper ones.
+template <int R, int C>
+class GameSession {
+ public:
+  GameSession() { sit_.SetStartingSituation(); }
+
+  // The AI, e.g., to change its settings.
+  Negamax<R, C>& AI() { return negamax_; }
+
+  const Situation<R, C>& CurrentSituation() const { return sit_; }
+
+  // Plies played since the start of the game.
+  int NumPlies() const { return num_plies_; }
+
+  // Forgets the game and the search state, and starts a new game.
+  void NewGame() {
+    negamax_.ClearTT();
+    ResetSituation();
+  }
+
+  // Plays `move` for the player to move. Returns false, and does nothing, if
+  // the move is illegal or the game is over.
+  bool PlayMove(Move move) {
+    if (sit_.IsGameOver() || !sit_.IsLegalMove(move)) return false;
+    const std::string notation = sit_.MoveToStandardNotation(move);
+    sit_.ApplyMove(move);
+    ++num_plies_;
+    if (plies_since_search_ != -1) ++plies_since_search_;
+    if (!standard_notation_.empty()) standard_notation_ += ' ';
+    standard_notation_ += std::to_string(num_plies_) + ". " + notation;
+    return true;
+  }
+
+  // Same as above for a move in standard notation, e.g., "b3v c2>".
+  bool PlayMove(const std::string& move_notation) {
+    Move move;
+    if (!sit_.StandardNotationToMove(move_notation, move)) return false;
+    return PlayMove(move);
+  }
+
+  // Brings the session to the situation after `standard_notation`, the whole
+  // game so far (e.g., "1. b2 2. b3v c2>"). If it continues the moves already
+  // played, only the new moves are parsed and played. Otherwise, the game is
+  // replayed from the start, but the TT is kept, since its entries are valid
+  // in any game. Returns whether parsing succeeded and every move was legal.
+  bool SyncWithStandardNotation(std::string standard_notation) {
+    while (!standard_notation.empty() &&
+           sit_.IsWhiteSpace(standard_notation.back()))
+      standard_notation.pop_back();
+    const std::size_t n = standard_notation_.size();
+    const bool continues_game =
+        standard_notation.compare(0, n, standard_notation_) == 0 &&
+        (n == 0 || standard_notation.size() == n ||
+         sit_.IsWhiteSpace(standard_notation[n]));
+    if (!continues_game) ResetSituation();
+    std::vector<typename Situation<R, C>::ParsedMove> parsed_moves;
+    std::vector<std::string> notated_moves;
+    if (!sit_.ParseMoveList(standard_notation.substr(standard_notation_.size()),
+                            parsed_moves, notated_moves, num_plies_ + 1))
+      return false;
+    for (const auto& parsed_move : parsed_moves) {
+      if (!PlayMove(sit_.ParsedMoveToMove(parsed_move))) return false;
+    }
+    // The notation may be formatted differently from ours.
+    standard_notation_ = standard_notation;
+    return true;
+  }
+
+  // Returns the AI's move for the player to move within `limits`, without
+  // playing it. The game must not be over.
+  Move GetMove(const TimeLimits& limits, int max_depth = kMaxDepth - 1) {
+    negamax_.AdvanceRoot(plies_since_search_);
+    plies_since_search_ = 0;
+    return negamax_.GetMove(sit_, limits, max_depth);
+  }
+  Move GetMove(int millis, int max_depth = kMaxDepth - 1) {
+    return GetMove(FixedTimeLimits(millis), max_depth);
+  }
+
+  // Searches on the opponent's time after the AI's move was played. See
+  // `Negamax::StartPondering`.
+  void StartPondering() { negamax_.StartPondering(sit_); }
+
+ private:
+  void ResetSituation() {
+    sit_.SetStartingSituation();
+    num_plies_ = 0;
+    plies_since_search_ = -1;
+    standard_notation_.clear();
+  }
+
+  Negamax<R, C> negamax_;
+  Situation<R, C> sit_;
+  int num_plies_ = 0;
+  // Plies played since the last `GetMove`, or -1 if there was none.
+  int plies_since_search_ = -1;
+  // The moves played so far, in standard notation.
+  std::string standard_notation_;
+};
+
+}  // namespace wallwars
+
+#endif  // GAME_SESSION_H_
@@ -163,6 +163,17 @@ constexpr bool IsRealEdge(int R, int C, int e) {
                               : !IsFakeVerticalEdge(R, C, e));
 }
 
+// Left-right mirror image of node v.
+constexpr int MirrorNode(int C, int v) {
+  return NodeAt(C, Row(C, v), C - 1 - Col(C, v));
+}
+// Left-right mirror image of a real edge e. A horizontal edge becomes the edge
+// to the left of the mirror image of its left endpoint.
+constexpr int MirrorEdge(int C, int e) {
+  return IsHorizontalEdge(e) ? EdgeLeft(C, MirrorNode(C, EndpointLeft(e)))
+                             : 2 * MirrorNode(C, EndpointAbove(e)) + 1;
+}
+
 template <int R, int C>
 std::bitset<NumRealAndFakeEdges(R, C)> PathAsEdgeSet(
     std::array<int, NumNodes(R, C)> path) {
@@ -449,6 +460,41 @@ struct Graph {
     return {};
   }
 
+  // Returns the edges that are in every shortest path from `s` to `t`, i.e.,
+  // the edges whose removal increases the distance, ordered from `s` to `t`.
+  // The output array contains -1's after the last edge. Assumes that `t` is
+  // reachable from `s`.
+  std::array<int, NumNodes(R, C)> EdgesInEveryShortestPath(int s, int t) const {
+    const std::array<int, NumNodes(R, C)> dist_from_s = Distances(s);
+    const std::array<int, NumNodes(R, C)> dist_to_t = Distances(t);
+    const int dist = dist_from_s[t];
+    // For each `i`, the number of edges from a node at distance `i` from `s`
+    // to a node at distance `i`+1 in some shortest path, and the last one.
+    std::array<int, NumNodes(R, C)> num_edges_at_distance;
+    num_edges_at_distance.fill(0);
+    std::array<int, NumNodes(R, C)> edge_at_distance;
+    for (int node = 0; node < NumNodes(R, C); ++node) {
+      const int i = dist_from_s[node];
+      if (i == -1 || i + dist_to_t[node] != dist || node == t) continue;
+      for (int nbr : GetNeighbors(node)) {
+        if (nbr != -1 && dist_from_s[nbr] == i + 1 &&
+            dist_to_t[nbr] == dist_to_t[node] - 1) {
+          ++num_edges_at_distance[i];
+          edge_at_distance[i] = EdgeBetweenNeighbors(R, C, node, nbr);
+        }
+      }
+    }
+    std::array<int, NumNodes(R, C)> edges;
+    edges.fill(-1);
+    int num_edges = 0;
+    for (int i = 0; i < dist; ++i) {
+      if (num_edges_at_distance[i] == 1) {
+        edges[num_edges++] = edge_at_distance[i];
+      }
+    }
+    return edges;
+  }
+
   // Returns the sequence of nodes in a shortest path from `s` to `t`, both
   // included, respecting orientations. There is an orientation for each
   // edge. 1 means it can only be used in the direction from the smallest- to
@@ -531,7 +577,7 @@ struct Graph {
   // Returns the set of edges which are bridges.
   std::bitset<NumRealAndFakeEdges(R, C)> Bridges() const {
     METRIC_INC(graph_primitives);
-    static BridgesState state;
+    thread_local BridgesState state;
     state.rank.fill(-1);
     state.next_rank = 0;
     state.low_link.fill(-1);
@@ -12,7 +12,9 @@
 #include "assert.h"
 #include "benchmark_metrics.h"
 #include "constants.h"
+#include "game_session.h"
 #include "graph.h"
+#include "mcts.h"
 #include "negamax.h"
 #include "situation.h"
 
@@ -23,8 +25,13 @@ class InteractiveGame {
   static constexpr int R = kInteractiveGameR;
   static constexpr int C = kInteractiveGameC;
 
-  static void PlayGame() {
+  // `num_threads` is the number of threads used by each AI (see
+  // `Negamax::SetNumThreads` and `Mcts::SetNumThreads`).
+  static void PlayGame(int num_threads = 1) {
     InteractiveGame game;
+    for (GameSession<R, C>& session : game.sessions)
+      session.AI().SetNumThreads(num_threads);
+    for (Mcts<R, C>& mcts : game.mcts_engines) mcts.SetNumThreads(num_threads);
     game.Play();
   }
 
@@ -34,12 +41,16 @@ class InteractiveGame {
     while (true) {
       std::string P0_type = auto_moves[0] ? "auto" : "manual";
       std::string P1_type = auto_moves[1] ? "auto" : "manual";
+      std::string P0_AI = use_mcts[0] ? "MCTS" : "Negamax";
+      std::string P1_AI = use_mcts[1] ? "MCTS" : "Negamax";
       std::cout << "Enter a number to choose:" << std::endl
                 << "(1) Start game (" << P0_type << " vs " << P1_type << ")"
                 << std::endl
                 << "(2) Change P0 (current: " << P0_type << ")" << std::endl
                 << "(3) Change P1 (current: " << P1_type << ")" << std::endl
-                << "(4) Quit." << std::endl
+                << "(4) Change P0 AI (current: " << P0_AI << ")" << std::endl
+                << "(5) Change P1 AI (current: " << P1_AI << ")" << std::endl
+                << "(6) Quit." << std::endl
                 << ">> ";
       char menu_option;
       std::cin >> menu_option;
@@ -53,6 +64,12 @@ class InteractiveGame {
         case '3':
           auto_moves[1] = !auto_moves[1];
           break;
+        case '4':
+          use_mcts[0] = !use_mcts[0];
+          break;
+        case '5':
+          use_mcts[1] = !use_mcts[1];
+          break;
         default:
           return;
       }
@@ -60,9 +77,16 @@ class InteractiveGame {
   }
 
  private:
+  // Returns the move of the AI of the player to move in `sit`.
+  Move GetAIMove(const Situation<R, C>& sit) {
+    if (use_mcts[sit.turn])
+      return mcts_engines[sit.turn].GetMove(sit, kInteractiveGameMillis);
+    return sessions[sit.turn].GetMove(kInteractiveGameMillis);
+  }
+
   // Asks human for a move through the CLI. If the human wants, it can defer to
-  // the Negamax by inputting 'x'.
-  Move GetHumanMove(Situation<R, C> sit, Negamax<R, C>& negamaxer) {
+  // the AI of `session` by inputting 'x'.
+  Move GetHumanMove(Situation<R, C> sit, GameSession<R, C>& session) {
     static std::map<std::string, int> direction_letter_to_index = {
         {"N", 0}, {"E", 1}, {"S", 2}, {"W", 3},
         {"n", 0}, {"e", 1}, {"s", 2}, {"w", 3}};
@@ -81,7 +105,7 @@ class InteractiveGame {
         std::string s;
         std::getline(std::cin, s);
         if (s == "x") {
-          return negamaxer.GetMove(sit, kInteractiveGameMillis);
+          return session.GetMove(kInteractiveGameMillis);
         }
         if (direction_letter_to_index.count(s)) {
           int dir = direction_letter_to_index.at(s);
@@ -140,7 +164,7 @@ class InteractiveGame {
   // `auto_moves` is an array which indicates, for P0 and P1, whether
   // the AI should make the move.
   void PlayGame(std::array<bool, 2> auto_moves) {
-    std::array<Negamax<R, C>, 2> negamaxers;
+    for (GameSession<R, C>& session : sessions) session.NewGame();
 
     Situation<R, C> sit = StartingSituation<R, C>();
     for (int ply = 0; !sit.IsGameOver(); ++ply) {
@@ -152,10 +176,8 @@ class InteractiveGame {
                 << (auto_moves[sit.turn] ? " (auto)" : "") << std::endl;
       global_metrics = {};
       auto start_time = high_resolution_clock::now();
-      Move move =
-          auto_moves[sit.turn]
-              ? negamaxers[sit.turn].GetMove(sit, kInteractiveGameMillis)
-              : GetHumanMove(sit, negamaxers[sit.turn]);
+      Move move = auto_moves[sit.turn] ? GetAIMove(sit)
+                                       : GetHumanMove(sit, sessions[sit.turn]);
       auto stop_time = high_resolution_clock::now();
       seconds duration_s = duration_cast<seconds>(stop_time - start_time);
       if (move == Move{0, {-1, -1}}) {
@@ -170,9 +192,22 @@ class InteractiveGame {
         }
       }
       sit.ApplyMove(move);
+      for (GameSession<R, C>& session : sessions) session.PlayMove(move);
+      // The AI thinks on the human's time.
+      if (auto_moves[1 - sit.turn] && !use_mcts[1 - sit.turn] &&
+          !auto_moves[sit.turn]) {
+        sessions[1 - sit.turn].StartPondering();
+      }
     }
+    for (GameSession<R, C>& session : sessions) session.AI().StopPondering();
     PrintWinner(sit);
   }
+
+  // One AI per player, which follows the game. They are reused across games.
+  std::array<GameSession<R, C>, 2> sessions;
+  // Whether each player uses MCTS instead of the AI of its session.
+  std::array<bool, 2> use_mcts = {false, false};
+  std::array<Mcts<R, C>, 2> mcts_engines;
 };
 
 }  // namespace wallwars
@@ -143,6 +143,16 @@ namespace wallwars {
   } while (0)
 #endif
 
+// Hints the CPU to load the cache line at address `addr`. It does nothing in
+// compilers without the builtin.
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH(addr) __builtin_prefetch(addr)
+#else
+#define PREFETCH(addr) \
+  do {                 \
+  } while (0)
+#endif
+
 }  // namespace wallwars
 
 #endif  // MACRO_UTILS_H_
\ No newline at end of file
@@ -0,0 +1,277 @@
+#ifndef MCTS_H_
+#define MCTS_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "benchmark_metrics.h"
+#include "graph.h"
+#include "move.h"
+#include "negamax.h"
+#include "situation.h"
+#include "transposition_table.h"
+
+namespace wallwars {
+
+// Monte Carlo Tree Search (MCTS) with UCT, an alternative to `Negamax` for big
+// boards, where the number of legal moves makes alpha-beta search shallow.
+// Each playout descends the tree by UCT, expands the leaf, and finishes the
+// game with a fast rollout guided by shortest paths. The children of a node
+// are the best moves of `Negamax::OrderedMoves`, which are added to the
+// selection in that order as the node gets more visits (progressive
+// widening). With several threads, the threads run playouts in the same tree
+// (tree parallelization), and each node on the path of a running playout
+// counts as a lost playout (virtual loss), so that the other threads explore
+// other paths.
+template <int R, int C>
+class Mcts {
+  // UCT explores the child maximizing win rate + `kExplorationConstant` *
+  // sqrt(ln(parent visits) / child visits). Results are in [0, 1].
+  static constexpr double kExplorationConstant = 0.7;
+  // A node with `n` visits selects among its best `kMinWidth` + sqrt(`n`)
+  // children, and has at most `kMaxChildren` children.
+  static constexpr int kMinWidth = 2;
+  static constexpr int kMaxChildren = 64;
+  // Leaves are expanded once they have this many visits, so that leaves
+  // visited only once do not pay for the move generation.
+  static constexpr int kExpansionVisits = 2;
+  // In a rollout, the player to move walks two steps along a shortest path to
+  // its goal, or, with probability 1 / `kRolloutWallOdds`, walks one step and
+  // builds a wall on a shortest path of the opponent. After
+  // `kMaxRolloutPlies` plies, the player closer to its goal wins.
+  static constexpr int kRolloutWallOdds = 2;
+  static constexpr int kRolloutWallAttempts = 3;
+  static constexpr int kMaxRolloutPlies = 4 * (R + C);
+
+  struct Node {
+    // The move from the parent.
+    Move move;
+    std::atomic<int> visits{0};
+    // Running playouts through the node, which count as lost until they end.
+    std::atomic<int> virtual_losses{0};
+    // Sum of the results of the playouts through the node for the player who
+    // played `move`: 2 for a win, 1 for a draw, and 0 for a loss.
+    std::atomic<int> result_sum{0};
+    // -1 until the node is expanded. `children` is written before it.
+    std::atomic<int> num_children{-1};
+    std::unique_ptr<Node[]> children;
+    std::mutex expansion_mutex;
+  };
+
+ public:
+  // Sets the number of threads that run playouts in `GetMove`.
+  void SetNumThreads(int num_threads) {
+    num_threads_ = std::max(num_threads, 1);
+  }
+
+  // Returns the most visited root move after `millis` milliseconds, or after
+  // `max_playouts` playouts if it is faster. The tree is not kept between
+  // calls.
+  Move GetMove(Situation<R, C> sit, int millis,
+               long long max_playouts = std::numeric_limits<long long>::max()) {
+    const auto deadline = std::chrono::steady_clock::now() +
+                          std::chrono::milliseconds(millis);
+    while (static_cast<int>(generators_.size()) < num_threads_)
+      generators_.push_back(std::make_unique<Negamax<R, C>>());
+    root_sit_ = sit;
+    root_ = std::make_unique<Node>();
+    Expand(*root_, sit, *generators_[0]);
+    const int num_root_children = root_->num_children.load();
+    // A winning move is the only child of the root.
+    if (num_root_children == 1) return root_->children[0].move;
+
+    playouts_left_ = max_playouts;
+    std::mutex metrics_mutex;
+    BenchmarkMetrics helper_metrics = {};
+    std::vector<std::thread> helpers;
+    for (int i = 1; i < num_threads_; ++i) {
+      helpers.emplace_back([&, i]() {
+        RunPlayouts(*generators_[i], deadline, i);
+        std::lock_guard<std::mutex> lock(metrics_mutex);
+        helper_metrics.Add(global_metrics);
+      });
+    }
+    RunPlayouts(*generators_[0], deadline, 0);
+    for (std::thread& helper : helpers) helper.join();
+    if (kBenchmark) global_metrics.Add(helper_metrics);
+
+    const Node* best = &root_->children[0];
+    for (int i = 1; i < num_root_children; ++i) {
+      if (root_->children[i].visits > best->visits) best = &root_->children[i];
+    }
+    std::cout << "MCTS: " << root_->visits << " playouts, best move "
+              << sit.MoveToStandardNotation(best->move) << " (visits: "
+              << best->visits << ", win rate: "
+              << 50 * best->result_sum / std::max(best->visits.load(), 1)
+              << "%)" << std::endl;
+    return best->move;
+  }
+
+ private:
+  void RunPlayouts(Negamax<R, C>& generator,
+                   std::chrono::steady_clock::time_point deadline,
+                   int thread_index) {
+    uint64_t rng_state = thread_index;
+    std::vector<Node*> path;
+    while (playouts_left_.fetch_sub(1) > 0 &&
+           std::chrono::steady_clock::now() < deadline) {
+      Playout(generator, path, rng_state);
+      METRIC_INC(mcts_playouts);
+    }
+  }
+
+  void Playout(Negamax<R, C>& generator, std::vector<Node*>& path,
+               uint64_t& rng_state) {
+    Situation<R, C> sit = root_sit_;
+    path.clear();
+    path.push_back(root_.get());
+    Node* node = root_.get();
+    while (!sit.IsGameOver()) {
+      int num_children = node->num_children.load(std::memory_order_acquire);
+      if (num_children == -1 && node->visits >= kExpansionVisits) {
+        // If another thread is expanding the node, it is a leaf for now.
+        std::unique_lock<std::mutex> lock(node->expansion_mutex,
+                                          std::try_to_lock);
+        if (lock.owns_lock()) {
+          if (node->num_children == -1) Expand(*node, sit, generator);
+          num_children = node->num_children.load(std::memory_order_acquire);
+        }
+      }
+      if (num_children == -1) break;
+      node = SelectChild(*node, num_children);
+      ++node->virtual_losses;
+      sit.ApplyMove(node->move);
+      path.push_back(node);
+    }
+    const int winner =
+        sit.IsGameOver() ? sit.Winner() : Rollout(sit, rng_state);
+    // The root's move is played by the opponent of the player to move.
+    int mover = 1 - root_sit_.turn;
+    for (Node* path_node : path) {
+      if (path_node != root_.get()) --path_node->virtual_losses;
+      ++path_node->visits;
+      path_node->result_sum += winner == 2 ? 1 : (winner == mover ? 2 : 0);
+      mover = 1 - mover;
+    }
+  }
+
+  // Makes the best moves of `generator.OrderedMoves` for `sit` the children of
+  // `node`.
+  void Expand(Node& node, const Situation<R, C>& sit,
+              Negamax<R, C>& generator) {
+    generator.SetRootSituation(sit);
+    std::vector<Move> moves;
+    for (const ScoredMove& scored_move : generator.OrderedMoves(0)) {
+      if (static_cast<int>(moves.size()) == kMaxChildren) break;
+      if (scored_move.score == Negamax<R, C>::kPossiblyIllegalMoveScore &&
+          !sit.IsLegalMove(scored_move.move))
+        continue;
+      moves.push_back(scored_move.move);
+    }
+    node.children = std::make_unique<Node[]>(moves.size());
+    for (std::size_t i = 0; i < moves.size(); ++i)
+      node.children[i].move = moves[i];
+    node.num_children.store(static_cast<int>(moves.size()),
+                            std::memory_order_release);
+  }
+
+  // Returns the child of `node` with the highest UCT score among the best ones
+  // (see `kMinWidth`), or the first unvisited one.
+  Node* SelectChild(Node& node, int num_children) {
+    const int parent_visits = node.visits + node.virtual_losses;
+    const int width = std::min(
+        num_children,
+        kMinWidth + static_cast<int>(std::sqrt(static_cast<double>(
+                        parent_visits))));
+    const double log_parent_visits = std::log(std::max(parent_visits, 1));
+    Node* best = nullptr;
+    double best_score = -1;
+    for (int i = 0; i < width; ++i) {
+      Node& child = node.children[i];
+      const int visits = child.visits + child.virtual_losses;
+      if (visits == 0) return &child;
+      const double score =
+          child.result_sum / (2.0 * visits) +
+          kExplorationConstant * std::sqrt(log_parent_visits / visits);
+      if (score > best_score) {
+        best_score = score;
+        best = &child;
+      }
+    }
+    return best;
+  }
+
+  // Plays `sit` until the end, or for `kMaxRolloutPlies` plies, and returns the
+  // winner, as in `Situation::Winner`.
+  int Rollout(Situation<R, C>& sit, uint64_t& rng_state) {
+    for (int ply = 0; ply < kMaxRolloutPlies; ++ply) {
+      sit.ApplyMove(RolloutMove(sit, rng_state));
+      if (sit.IsGameOver()) return sit.Winner();
+    }
+    // Players walk two steps per move, and the player to move goes first.
+    std::array<int, 2> moves_to_goal;
+    for (int player : {0, 1}) {
+      moves_to_goal[player] =
+          (sit.G.Distance(sit.tokens[player], Goals(R, C)[player]) + 1) / 2;
+    }
+    return moves_to_goal[sit.turn] <= moves_to_goal[1 - sit.turn]
+               ? sit.turn
+               : 1 - sit.turn;
+  }
+
+  Move RolloutMove(const Situation<R, C>& sit, uint64_t& rng_state) {
+    const int token = sit.tokens[sit.turn];
+    const int goal = Goals(R, C)[sit.turn];
+    const std::array<int, NumNodes(R, C)> path =
+        sit.G.ShortestPath(token, goal);
+    // `path[2]` is -1 if the goal is one step away.
+    if (path[2] == goal ||
+        (path[2] != -1 && SplitMix64(rng_state) % kRolloutWallOdds != 0))
+      return DoubleWalkMove(token, path[2]);
+    const int opponent = 1 - sit.turn;
+    const std::array<int, NumNodes(R, C)> opponent_path =
+        sit.G.ShortestPath(sit.tokens[opponent], Goals(R, C)[opponent]);
+    int opponent_dist = 0;
+    while (opponent_dist + 1 < NumNodes(R, C) &&
+           opponent_path[opponent_dist + 1] != -1)
+      ++opponent_dist;
+    for (int i = 0; i < kRolloutWallAttempts; ++i) {
+      const int index = SplitMix64(rng_state) % opponent_dist;
+      const Move move = WalkAndBuildMove(
+          token, path[1],
+          EdgeBetweenNeighbors(R, C, opponent_path[index],
+                               opponent_path[index + 1]));
+      if (sit.IsLegalMove(move)) return move;
+    }
+    if (path[2] != -1) return DoubleWalkMove(token, path[2]);
+    // The goal is one step away: any wall wins, if there is one.
+    for (int edge = 0; edge < NumRealAndFakeEdges(R, C); ++edge) {
+      const Move move = WalkAndBuildMove(token, goal, edge);
+      if (IsRealEdge(R, C, edge) && sit.G.edges[edge] && sit.IsLegalMove(move))
+        return move;
+    }
+    return sit.AllLegalMoves()[0];
+  }
+
+  int num_threads_ = 1;
+  // One per thread, used for `OrderedMoves`.
+  std::vector<std::unique_ptr<Negamax<R, C>>> generators_;
+  Situation<R, C> root_sit_;
+  std::unique_ptr<Node> root_;
+  std::atomic<long long> playouts_left_;
+
+  friend class Tests;
+};
+
+}  // namespace wallwars
+
+#endif  // MCTS_H_
@@ -1,21 +1,57 @@
 #ifndef NEGAMAX_H_
 #define NEGAMAX_H_
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <bitset>
 #include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include "benchmark_metrics.h"
 #include "constants.h"
+#include "eval_cache.h"
 #include "external/span.h"
 #include "graph.h"
 #include "macro_utils.h"
 #include "move.h"
+#include "nnue.h"
+#include "proof_number_table.h"
 #include "situation.h"
+#include "time_manager.h"
 #include "transposition_table.h"
+#include "work_stealing_pool.h"
 
 namespace wallwars {
+
+// How `Negamax::GetMove` uses multiple threads. See `Negamax::SetNumThreads`.
+enum class ParallelMode { kLazySMP, kYBWC };
+
+// How `Negamax::GetMove` searches the root at each iterative-deepening depth.
+// See `Negamax::SetRootAlgorithm`.
+enum class RootAlgorithm { kAlphaBeta, kMTDf };
+
+// A root move ranked by `Negamax::GetTopMoves`.
+struct RankedMove {
+  Move move;
+  // The exact eval of `move` at the depth of the search, from the point of
+  // view of the player to move.
+  int eval;
+  // The principal variation, which starts with `move`.
+  std::vector<Move> pv;
+};
+
+// Uses the move generator of `Negamax`. See mcts.h.
+template <int R, int C>
+class Mcts;
+
 template <int R, int C>
 class Negamax {
   static constexpr int kGameOverEval = 999;  // Larger than any real evaluation.
@@ -23,60 +59,587 @@ class Negamax {
   static constexpr int kPossiblyIllegalMoveScore = -5000;
   static constexpr int kWinningMoveScore = 10000;
 
-  TranspositionTable<R, C> TT;
+  // Only set for the main searcher, which owns the TT. With Lazy SMP, the
+  // helpers use the TT of the main searcher.
+  std::unique_ptr<TranspositionTable<R, C>> owned_TT_;
+  TranspositionTable<R, C>& TT;
+  // Same for the evaluation cache. See `GoalDistances`.
+  std::unique_ptr<EvalCache> owned_eval_cache_;
+  EvalCache& eval_cache_;
+
+  // Number of threads used by `GetMove`. See `SetNumThreads`.
+  int num_threads_ = 1;
+  ParallelMode parallel_mode_ = ParallelMode::kLazySMP;
+  // Only set for Lazy SMP helpers. The helper stops when it becomes true.
+  const std::atomic<bool>* stop_ = nullptr;
+  // 0 for the main searcher. Helpers use it to perturb the move order.
+  uint64_t move_order_seed_ = 0;
+
+  // Token changes range from -2*C (walking two rows up) to 2*C.
+  static constexpr int kNumTokenChanges = 4 * C + 1;
+
+  // Dynamic move-ordering heuristics, learned from the beta cutoffs of the
+  // search (see `RecordCutoff`) and added to the static scores of
+  // `OrderedMoves` (see `AddHeuristicScores`).
+  struct MoveOrderingTables {
+    // The last two moves that caused a cutoff at each ply. A move that refutes
+    // a node often refutes its siblings too.
+    std::array<std::array<Move, 2>, kMaxDepth + 1> killers;
+    // History ("butterfly") tables for each player: how much the walls built
+    // on each edge and the walks with each token change caused cutoffs,
+    // weighted by depth squared.
+    std::array<std::array<int, NumRealAndFakeEdges(R, C)>, 2> wall_history;
+    std::array<std::array<int, kNumTokenChanges>, 2> walk_history;
+    // For each player, the last move that caused a cutoff in response to each
+    // move of the opponent, indexed by `CountermoveIndex`.
+    std::array<std::array<Move, NumRealAndFakeEdges(R, C) + kNumTokenChanges>,
+               2>
+        countermoves;
+  };
+  static constexpr int kFirstKillerBonus = 40;
+  static constexpr int kSecondKillerBonus = 30;
+  static constexpr int kCountermoveBonus = 20;
+  // History values are halved when one exceeds `kMaxHistory`. A history value
+  // of `kMaxHistory` is worth a bonus of `kMaxHistoryBonus`.
+  static constexpr int kMaxHistory = 1 << 14;
+  static constexpr int kMaxHistoryBonus = 10;
+  // On the heap because of the size on big boards.
+  std::unique_ptr<MoveOrderingTables> tables_ =
+      std::make_unique<MoveOrderingTables>();
+  // The move that led to each ply of the current search path. It is
+  // `kNullMove` after a pass of null-move pruning.
+  std::array<Move, kMaxDepth + 1> moves_to_ply_;
+  static constexpr Move kNullMove = {0, {-1, -1}};
+  // The ply of `sit_` in the current search, i.e., the number of moves applied
+  // to the root. With reductions, it is not always `ID_depth - depth`.
+  int ply_ = 0;
+
+  // How many moves ahead in the move list we prefetch the TT entries of the
+  // children.
+  static constexpr int kTTPrefetchDistance = 2;
+
+  // Half-width of the aspiration window around the eval of the previous
+  // iterative-deepening iteration. The window doubles after each failure.
+  static constexpr int kAspirationWindow = 2;
+  // See `SetRootAlgorithm`.
+  RootAlgorithm root_algorithm_ = RootAlgorithm::kAlphaBeta;
+  // See `SetResumeFromTT`.
+  bool resume_from_TT_ = false;
+  // Plies from the root of the last search to the root of the next one, or -1
+  // if unknown. See `AdvanceRoot`.
+  int root_advance_ = -1;
+  // Multi-PV: the number of root moves ranked at each depth (0 outside of
+  // `GetTopMoves`), the moves ranked at the last completed depth, and the
+  // moves ranked so far at the current one, which the root search skips.
+  int num_pvs_ = 0;
+  std::vector<RankedMove> ranked_moves_;
+  std::vector<Move> excluded_root_moves_;
+
+  // Late move reductions (LMR): at nodes with `depth >= kLMRMinDepth`, moves
+  // from `StagedMoves` with index at least `kLMRMinMoveIndex` or with a score
+  // of at most `kLMRWeakMoveScore` are searched with a null window at one ply
+  // less than normal, or two plies less if both apply. Most of them fail low,
+  // which confirms that they are bad. The ones that fail high are searched
+  // again at full depth. See `SetLateMoveReductions`.
+  static constexpr int kLMRMinDepth = 3;
+  static constexpr int kLMRMinMoveIndex = 3;
+  static constexpr int kLMRWeakMoveScore = 0;
+  bool late_move_reductions_ = true;
+
+  // Futility pruning and razoring, based on the static eval (`LeafEval`) of
+  // the player to move. A move changes the eval by a few steps of distance
+  // unless it wins or builds a long detour for the opponent, so:
+  // - A node at depth 1 whose static eval is at least `kFutilityMargin` below
+  //   alpha fails low without searching any child.
+  // - A node at depth 2 whose static eval is at least `kRazoringMargin` below
+  //   alpha is searched at depth 1 first, and fails low if that search does.
+  // Neither applies to PV nodes, or if the player to move can win
+  // immediately. See `SetFutilityPruning`.
+  static constexpr int kFutilityMargin = 3;
+  static constexpr int kRazoringMargin = 5;
+  bool futility_pruning_ = true;
+
+  // Enhanced transposition cutoffs (ETC): at nodes with depth at least
+  // `etc_min_depth_`, before searching the moves from `StagedMoves`, the TT
+  // entries of the children reached by the first `etc_max_moves_` of them are
+  // read, and the node fails high without searching if one of them proves
+  // that a child's eval refutes it. See `SetEnhancedTranspositionCutoffs`.
+  static constexpr int kDefaultETCMinDepth = 3;
+  static constexpr int kDefaultETCMaxMoves = 4;
+  int etc_min_depth_ = kDefaultETCMinDepth;
+  int etc_max_moves_ = kDefaultETCMaxMoves;
+
+  // Internal iterative deepening (IID): a node with depth at least
+  // `kIIDMinDepth` and no legal move in its TT entry (e.g., because it has no
+  // entry) is first searched `kIIDReduction` plies shallower, and the best move
+  // of that search, which it stores in the TT, is tried first, as the cached
+  // move. See `SetInternalIterativeDeepening`.
+  static constexpr int kIIDMinDepth = 4;
+  static constexpr int kIIDReduction = 2;
+  bool internal_iterative_deepening_ = true;
+
+  // Null-move pruning: passing is illegal, but it is rarely better than the
+  // best move, so a non-PV node with depth at least `kNullMoveMinDepth` whose
+  // static eval is at least beta is first searched with the turn passed to the
+  // opponent, at `kNullMoveReduction` plies less than its children and with a
+  // null window. If the opponent cannot bring the eval below beta even with
+  // the free move, the node fails high without searching its moves. Passing is
+  // worse than every move only if the player to move can build a wall: a
+  // player that can only walk may have to walk away from its goal (see the
+  // example in `OrderedMoves`), so such nodes are never pruned. Nor are nodes
+  // where a player is within 2 of its goal, where the draw rule depends on
+  // the turn, or two null moves in a row. See `SetNullMovePruning`.
+  static constexpr int kNullMoveMinDepth = 3;
+  static constexpr int kNullMoveReduction = 2;
+  bool null_move_pruning_ = true;
+
+  // Quiescence search: at depth 0, instead of returning the static eval, the
+  // search checks whether the player to move can reach the goal with its next
+  // move, and extends forcing moves: walk-and-build moves along the player's
+  // shortest path whose wall is in every shortest path of the opponent, which
+  // lengthens it. Walls are only extended when the opponent is within
+  // `kQuiescenceThreatDistance` of its goal: elsewhere they rarely change the
+  // eval and made the search much slower. At most `kQuiescenceMaxMoves` moves
+  // are extended at each node, and at most `kQuiescenceNodeBudget` nodes are
+  // extended below each node at depth 0. See `SetQuiescenceSearch`.
+  static constexpr int kQuiescenceThreatDistance = 3;
+  static constexpr int kQuiescenceMaxMoves = 2;
+  static constexpr int kQuiescenceNodeBudget = 4;
+  bool quiescence_search_ = true;
+  // See `SolveRace`.
+  bool race_solver_ = true;
+  // See `GoalDistances`.
+  bool eval_cache_enabled_ = true;
+  // Nodes that the current quiescence search can still extend.
+  int quiescence_nodes_left_ = 0;
+
+  // State of the proof-number searches of `Solve`. The table is only
+  // allocated by the first call. See `ProveGoal`.
+  // A child is searched until its `delta` exceeds the second smallest one by
+  // more than 1 / `kDfpnThresholdSlackDivisor` of it (the 1 + epsilon trick),
+  // rather than by 1, so that df-pn switches less often between siblings and
+  // re-expands their parent fewer times.
+  static constexpr int kDfpnThresholdSlackDivisor = 4;
+  // Unexplored children start with a `delta` of 1 + their rank in
+  // `OrderedMoves` / `kDfpnMoveRankDivisor`, so that df-pn looks deeper into
+  // the best moves before it tries the worst ones.
+  static constexpr uint32_t kDfpnMoveRankDivisor = 4;
+  std::unique_ptr<ProofNumberTable<R, C>> proof_numbers_;
+  int dfpn_attacker_;
+  bool dfpn_draw_is_success_;
+  // Index of the goal in `proof_numbers_`.
+  int dfpn_goal_;
+  int dfpn_max_plies_;
+  long long dfpn_nodes_left_;
+  // The best root move found by the last search that expanded the root.
+  Move dfpn_root_move_;
+
+  // If set, the leaf evaluation adds the output of this network. See
+  // `SetNnue`. Its accumulator for `sit_` is updated with `ApplyMove` and
+  // `UndoMove`.
+  std::shared_ptr<const NnueWeights<R, C>> nnue_;
+  NnueAccumulator nnue_accumulator_;
 
   // The situation that moves are applied to to traverse the search tree.
   Situation<R, C> sit_;
+  // Hash of `sit_`, updated incrementally with `ApplyMove` and `UndoMove`.
+  uint64_t sit_hash_;
+  // Hash of `sit_.Mirrored()`, updated in the same way.
+  uint64_t sit_mirror_hash_;
+
+  // Where `sit_` is stored in the TT. With `kMirrorCanonicalization`, a
+  // situation and its mirror image share the location given by the smaller of
+  // their hashes. The one with the smaller hash is called canonical.
+  struct TTKey {
+    std::size_t location;
+    // Whether `sit_` is the mirror image of the canonical situation.
+    bool mirrored;
+  };
 
   int ID_depth;
-  std::chrono::high_resolution_clock::time_point search_start_timestamp;
-  int search_millis;
+  // The searchers of YBWC tasks use the time manager of the main searcher.
+  TimeManager own_time_manager_;
+  TimeManager* time_manager_ = &own_time_manager_;
+  // Nodes that this searcher visits before it polls the time manager again.
+  int nodes_until_time_poll_ = TimeManager::kPollIntervalNodes;
+
+  // Pondering: the thread started by `StartPondering` searches `ponder_sit_`
+  // until `GetMove` is called. `ponder_metrics_` are the metrics of that
+  // thread, which a ponder hit adds to those of the thread calling `GetMove`.
+  std::thread ponder_thread_;
+  Situation<R, C> ponder_sit_;
+  BenchmarkMetrics ponder_metrics_;
+  // Whether the current iterative-deepening iteration ran out of time before
+  // exploring every root move.
+  bool search_interrupted = false;
+
+  // Best move and eval found by the last search of the root, i.e., the last
+  // call to `NegamaxEval` with `depth == ID_depth`. With Lazy SMP, other
+  // threads write to the TT concurrently, so the result is not read from the
+  // root's TT entry.
+  Move root_move_;
+  int root_eval_;
+
+  // Move lists used by `OrderedMoves` and `StagedMoves`, one for each depth of
+  // the search. The size is an upper bound on the number of possible moves.
+  // They are on the heap because they take several MB on big boards.
+  using MoveList = std::array<ScoredMove, MaxNumLegalMoves(R, C)>;
+  using MoveLists = std::array<MoveList, kMaxDepth>;
+  std::unique_ptr<MoveLists> move_lists_ = std::make_unique<MoveLists>();
+
+  // Young Brothers Wait Concept (YBWC). A node is a split point if it has
+  // `depth >= kYBWCMinSplitDepth` and at least one of its children has already
+  // been searched. Then, its remaining children are searched in parallel as
+  // tasks of `pool_`.
+  static constexpr int kYBWCMinSplitDepth = 2;
+  struct SplitPoint {
+    // The split point of the searcher that created this one, if any.
+    const SplitPoint* parent;
+    int depth;
+    int beta;
+    bool is_root;
+    std::atomic<int> alpha;
+    // Set when a child causes a beta cutoff. It aborts the other children.
+    std::atomic<bool> cutoff{false};
+    // Set when a root child is skipped because the search ran out of time.
+    std::atomic<bool> interrupted{false};
+    std::mutex mutex;
+    // Guarded by `mutex`.
+    ScoredMove best_move;
+  };
+  // Only set during YBWC searches.
+  WorkStealingPool* pool_ = nullptr;
+  // For the searchers created to run YBWC tasks, the split point of the task.
+  const SplitPoint* split_point_ = nullptr;
+
+  // Constructor for Lazy SMP helpers.
+  Negamax(TranspositionTable<R, C>& shared_TT, EvalCache& shared_eval_cache,
+          const std::atomic<bool>& stop, uint64_t move_order_seed)
+      : TT(shared_TT),
+        eval_cache_(shared_eval_cache),
+        stop_(&stop),
+        move_order_seed_(move_order_seed) {}
+
+  // Constructor for the searchers of YBWC tasks, which search children of the
+  // situation of `parent`, the owner of `split_point`.
+  Negamax(const Negamax& parent, const SplitPoint& split_point)
+      : TT(parent.TT),
+        eval_cache_(parent.eval_cache_),
+        tables_(std::make_unique<MoveOrderingTables>(*parent.tables_)),
+        move_lists_(AcquireMoveLists()) {
+    sit_ = parent.sit_;
+    sit_hash_ = parent.sit_hash_;
+    sit_mirror_hash_ = parent.sit_mirror_hash_;
+    nnue_ = parent.nnue_;
+    nnue_accumulator_ = parent.nnue_accumulator_;
+    ID_depth = parent.ID_depth;
+    ply_ = parent.ply_;
+    late_move_reductions_ = parent.late_move_reductions_;
+    futility_pruning_ = parent.futility_pruning_;
+    etc_min_depth_ = parent.etc_min_depth_;
+    etc_max_moves_ = parent.etc_max_moves_;
+    internal_iterative_deepening_ = parent.internal_iterative_deepening_;
+    null_move_pruning_ = parent.null_move_pruning_;
+    quiescence_search_ = parent.quiescence_search_;
+    race_solver_ = parent.race_solver_;
+    eval_cache_enabled_ = parent.eval_cache_enabled_;
+    time_manager_ = parent.time_manager_;
+    search_interrupted = false;
+    pool_ = parent.pool_;
+    split_point_ = &split_point;
+  }
 
  public:
-  Move GetMove(Situation<R, C> sit, int millis) {
-    search_start_timestamp = std::chrono::high_resolution_clock::now();
-    search_millis = millis;
-    sit_ = sit;
-    for (ID_depth = 1; ID_depth < kMaxDepth; ++ID_depth) {
-      int alpha = -2 * kGameOverEval;
-      int beta = 2 * kGameOverEval;
+  Negamax()
+      : owned_TT_(std::make_unique<TranspositionTable<R, C>>()),
+        TT(*owned_TT_),
+        owned_eval_cache_(std::make_unique<EvalCache>()),
+        eval_cache_(*owned_eval_cache_) {}
+
+  ~Negamax() {
+    StopPondering();
+    if (split_point_ != nullptr) ReleaseMoveLists(std::move(move_lists_));
+  }
 
-      std::cout << "Search depth " << ID_depth << " with "
-                << millis - MillisSince(search_start_timestamp)
-                << " millis left." << std::endl;
+  // Sets the number of threads used by `GetMove` and how they are used:
+  // - Lazy SMP: the extra helper threads run the same iterative-deepening
+  //   search, sharing the TT, with staggered depths and perturbed move orders.
+  //   The helpers only contribute through the TT; the move returned is the one
+  //   found by the calling thread.
+  // - YBWC: the threads share the search tree. See `kYBWCMinSplitDepth`.
+  void SetNumThreads(int num_threads,
+                     ParallelMode parallel_mode = ParallelMode::kLazySMP) {
+    num_threads_ = std::max(num_threads, 1);
+    parallel_mode_ = parallel_mode;
+  }
 
-      // The search store the best move in the TT.
-      NegamaxEval(ID_depth, alpha, beta);
+  // Sets how the root is searched at each iterative-deepening depth:
+  // - Alpha-beta: a search with an aspiration window around the eval of the
+  //   previous depth, widened when the eval falls outside of it.
+  // - MTD(f): a sequence of null-window searches that converge to the eval,
+  //   starting from the eval of the previous depth. Evals are small integers,
+  //   so few searches are needed, and each one reuses the bounds that the
+  //   previous ones stored in the TT.
+  // Lazy SMP helpers always use full-window alpha-beta searches.
+  void SetRootAlgorithm(RootAlgorithm root_algorithm) {
+    root_algorithm_ = root_algorithm;
+  }
 
-      TTEntry<R, C>& entry = TT.Entry(TT.Location(sit));
-      std::cout << "Best move: "
-                << sit.MoveToStandardNotation(MoveInTTEntry(entry))
-                << " (eval: " << entry.eval << ")" << std::endl;
+  // If enabled, iterative deepening starts after the depth already searched for
+  // the root, according to its TT entry, instead of at depth 1. The first
+  // iteration may then not complete, in which case the move is the one in the
+  // TT. It is disabled by default. See `GameSession`.
+  void SetResumeFromTT(bool enabled) { resume_from_TT_ = enabled; }
+
+  // Tells the engine that the root of the next `GetMove` is `num_plies` moves
+  // after the root of the last one, so that the killer moves of the last search
+  // are reused for the plies that they share.
+  void AdvanceRoot(int num_plies) { root_advance_ = num_plies; }
+
+  // Enable or disable late move reductions (see `kLMRMinDepth`) and futility
+  // pruning and razoring (see `kFutilityMargin`). Both are enabled by default.
+  void SetLateMoveReductions(bool enabled) { late_move_reductions_ = enabled; }
+  void SetFutilityPruning(bool enabled) { futility_pruning_ = enabled; }
+  // Sets the minimum depth of the nodes that use enhanced transposition
+  // cutoffs (see `etc_min_depth_`), and the number of children whose TT entry
+  // they read. `max_moves` = 0 disables them. Children at depth 0 have no TT
+  // entries, so `min_depth` is at least 2.
+  void SetEnhancedTranspositionCutoffs(int min_depth, int max_moves) {
+    etc_min_depth_ = std::max(min_depth, 2);
+    etc_max_moves_ = max_moves;
+  }
+  // Enables or disables internal iterative deepening (see `kIIDMinDepth`). It
+  // is enabled by default.
+  void SetInternalIterativeDeepening(bool enabled) {
+    internal_iterative_deepening_ = enabled;
+  }
+  // Enables or disables null-move pruning (see `kNullMoveMinDepth`). It is
+  // enabled by default.
+  void SetNullMovePruning(bool enabled) { null_move_pruning_ = enabled; }
+  // Enables or disables the quiescence search at depth 0 (see
+  // `kQuiescenceNodeBudget`). It is enabled by default.
+  void SetQuiescenceSearch(bool enabled) { quiescence_search_ = enabled; }
+  // Enables or disables the exact race solver (see `SolveRace`). It is enabled
+  // by default.
+  void SetRaceSolver(bool enabled) { race_solver_ = enabled; }
+  // Enables or disables the evaluation cache (see `GoalDistances`). It is
+  // enabled by default.
+  void SetEvalCache(bool enabled) { eval_cache_enabled_ = enabled; }
+  // Sets the network whose output the leaf evaluation adds to the distance
+  // eval (see `LeafEval`), or none if `weights` is null, the default. The
+  // weights can be shared with other searchers.
+  void SetNnue(std::shared_ptr<const NnueWeights<R, C>> weights) {
+    nnue_ = std::move(weights);
+  }
+  // Same as above with weights read from `file_name`. Returns whether it
+  // succeeded. See `NnueWeights::Load`.
+  bool LoadNnue(const std::string& file_name) {
+    auto weights = std::make_shared<NnueWeights<R, C>>();
+    if (!weights->Load(file_name)) return false;
+    nnue_ = std::move(weights);
+    return true;
+  }
 
-      if (entry.eval >= kGameOverEval) {
-        std::cout << "Found winning move at depth " << ID_depth << "."
-                  << std::endl;
+  // Returns the best move found in `millis` milliseconds, or, if it is faster,
+  // after completing the iterative-deepening iteration at depth `max_depth`.
+  Move GetMove(Situation<R, C> sit, int millis, int max_depth = kMaxDepth - 1) {
+    return GetMove(sit, FixedTimeLimits(millis), max_depth);
+  }
+
+  // Returns the best move found within `limits`, e.g., `ClockTimeLimits` for
+  // the clock of the player to move, or, if it is faster, after completing the
+  // iterative-deepening iteration at depth `max_depth`. The first iteration
+  // always completes, so that there is a move. See `TimeManager`.
+  Move GetMove(Situation<R, C> sit, const TimeLimits& limits,
+               int max_depth = kMaxDepth - 1) {
+    // On a ponder hit, the ponder search continues with `limits`.
+    if (ponder_thread_.joinable() && sit == ponder_sit_ &&
+        max_depth == kMaxDepth - 1) {
+      std::cout << "Ponder hit." << std::endl;
+      time_manager_->PonderHit(limits);
+      ponder_thread_.join();
+      // `AdvanceRoot` counts from the last search, which is now this one.
+      root_advance_ = -1;
+      if (kBenchmark) {
+        global_metrics.Add(ponder_metrics_);
+        global_metrics.max_completed_depth =
+            ponder_metrics_.max_completed_depth;
+      }
+      sit.CrashIfMoveIsIllegal(root_move_);
+      return root_move_;
+    }
+    if (ponder_thread_.joinable()) {
+      StopPondering();
+      // The killers are those of the ponder search, whose root is not an
+      // ancestor of `sit`.
+      root_advance_ = -1;
+    }
+    time_manager_->Start(limits);
+    IterativeDeepening(sit, max_depth);
+    sit.CrashIfMoveIsIllegal(root_move_);
+    return root_move_;
+  }
+
+  // Multi-PV analysis, e.g., to rank alternatives for hints and game reviews:
+  // returns the best `num_moves` moves, or every legal move if there are
+  // fewer, from best to worst, with their evals and principal variations. At
+  // each iterative-deepening depth, the root is searched once per ranked move,
+  // each time skipping the moves already ranked, so that the eval of each move
+  // is exact. The passes share the TT. The result is the ranking of the last
+  // depth where every pass completed. The search stops as with `GetMove`, but
+  // a won position only stops it once every ranked move has a game-over eval.
+  std::vector<RankedMove> GetTopMoves(Situation<R, C> sit, int num_moves,
+                                      const TimeLimits& limits,
+                                      int max_depth = kMaxDepth - 1) {
+    StopPondering();
+    root_advance_ = -1;
+    num_pvs_ = std::max(num_moves, 1);
+    ranked_moves_.clear();
+    time_manager_->Start(limits);
+    IterativeDeepening(sit, max_depth);
+    num_pvs_ = 0;
+    for (const RankedMove& ranked_move : ranked_moves_)
+      sit.CrashIfMoveIsIllegal(ranked_move.move);
+    return ranked_moves_;
+  }
+  std::vector<RankedMove> GetTopMoves(Situation<R, C> sit, int num_moves,
+                                      int millis,
+                                      int max_depth = kMaxDepth - 1) {
+    return GetTopMoves(sit, num_moves, FixedTimeLimits(millis), max_depth);
+  }
+
+  // Solves `sit` with depth-first proof-number search (df-pn) instead of
+  // evaluating it: returns whether the player to move can force a win, can
+  // force a draw, or loses against any defense. Each outcome is proved by
+  // searches for goals of the players (see `ProveGoal`): a win for either
+  // player, or at least a draw for both. The searches are iteratively deepened
+  // from 1 to `max_plies` plies, so that short proofs are found first, and
+  // share a budget of `max_nodes` expanded nodes. If no outcome is proved
+  // within those limits, it is unknown. Proofs hold beyond `max_plies`, since
+  // the race solver only proves exact results.
+  SolveResult Solve(Situation<R, C> sit, long long max_nodes = kSolveMaxNodes,
+                    int max_plies = kMaxDepth - 1) {
+    StopPondering();
+    if (proof_numbers_ == nullptr)
+      proof_numbers_ = std::make_unique<ProofNumberTable<R, C>>();
+    proof_numbers_->NewQuery();
+    dfpn_nodes_left_ = max_nodes;
+    max_plies = std::min(max_plies, kMaxDepth - 1);
+    const int turn = sit.turn;
+    const int opp_turn = 1 - turn;
+    SolveResult result;
+    // A race is solved at once, with its move.
+    SetRootSituation(sit);
+    int race_eval;
+    if (race_solver_ && !sit.IsGameOver() &&
+        SolveRace(0, race_eval, &result.move)) {
+      if (race_eval == 0) {
+        result.outcome = SolveOutcome::kDraw;
+      } else {
+        result.outcome =
+            race_eval > 0 ? SolveOutcome::kWin : SolveOutcome::kLoss;
+      }
+      return result;
+    }
+    // Whether each player can force at least a draw, which stays proved with
+    // more plies.
+    std::array<bool, 2> draw_proved = {false, false};
+    Move draw_move;
+    for (int plies = 1; plies <= max_plies && dfpn_nodes_left_ > 0; ++plies) {
+      // A player wins with its own moves, so a win that takes an even
+      // (resp. odd) number of plies is for the opponent (resp. the player to
+      // move). Its proof is only searched with that parity. Solved races are
+      // the only exception, and they are also found with one more ply.
+      if (plies % 2 == 1 && ProveGoal(sit, turn, false, plies)) {
+        result.outcome = SolveOutcome::kWin;
+        result.move = dfpn_root_move_;
         break;
       }
-      if (entry.eval <= -kGameOverEval) {
-        std::cout << "Position is lost at depth " << ID_depth << "."
-                  << std::endl;
+      if (plies % 2 == 0 && ProveGoal(sit, opp_turn, false, plies)) {
+        result.outcome = SolveOutcome::kLoss;
+        break;
+      }
+      if (!draw_proved[turn] && ProveGoal(sit, turn, true, plies)) {
+        draw_proved[turn] = true;
+        draw_move = dfpn_root_move_;
+      }
+      if (draw_proved[turn] && !draw_proved[opp_turn])
+        draw_proved[opp_turn] = ProveGoal(sit, opp_turn, true, plies);
+      if (draw_proved[turn] && draw_proved[opp_turn]) {
+        result.outcome = SolveOutcome::kDraw;
+        result.move = draw_move;
         break;
       }
-      if (millis - MillisSince(search_start_timestamp) <= 0) break;
     }
+    result.num_nodes = max_nodes - dfpn_nodes_left_;
+    return result;
+  }
 
-    // Fetch best move from TT.
-    TTEntry<R, C> entry = TT.Entry(TT.Location(sit));
-    assert(entry.alpha_beta_flag == kExactFlag);
-    Move move = {entry.token_change, {entry.edge0, entry.edge1}};
-    sit.CrashIfMoveIsIllegal(move);
-    return move;
+  // Starts pondering on the opponent's time: `sit` is the situation after the
+  // move returned by `GetMove`, and a background thread searches the situation
+  // after the opponent's expected reply, the move cached in the TT for `sit`.
+  // If the next call to `GetMove` is for that situation, it continues the
+  // ponder search instead of starting a new one. Otherwise, the ponder search
+  // is stopped, and only what it stored in the TT remains. Until then, only
+  // `GetMove` and `StopPondering` may be called. Does nothing if there is no
+  // expected reply.
+  void StartPondering(const Situation<R, C>& sit) {
+    StopPondering();
+    if (sit.IsGameOver()) return;
+    SetRootSituation(sit);
+    const TTKey tt_key = CurrentTTKey();
+    TTEntry<R, C> tt_entry;
+    if (!TT.Probe(tt_key.location, sit_, tt_key.mirrored, tt_entry)) return;
+    const Move reply = MoveInTTEntry(tt_entry, tt_key);
+    if (!sit.IsLegalMove(reply)) return;
+    ponder_sit_ = sit;
+    ponder_sit_.ApplyMove(reply);
+    if (ponder_sit_.IsGameOver()) return;
+    time_manager_->StartPondering();
+    AdvanceRoot(2);
+    ponder_thread_ = std::thread([this]() {
+      global_metrics = {};
+      IterativeDeepening(ponder_sit_, kMaxDepth - 1);
+      ponder_metrics_ = global_metrics;
+    });
+  }
+
+  // Stops and discards the ponder search, if any.
+  void StopPondering() {
+    if (!ponder_thread_.joinable()) return;
+    time_manager_->Stop();
+    ponder_thread_.join();
+  }
+
+  // Forgets everything learned in previous searches, e.g., before starting a
+  // new game. Takes O(1) time.
+  void ClearTT() {
+    StopPondering();
+    TT.Clear();
+  }
+
+  // Saves the TT to a snapshot file, so that a later process can warm-start
+  // from it with `LoadTT()`. Both return whether they succeeded.
+  bool SaveTT(const std::string& file_name) const {
+    return TT.Save(file_name);
+  }
+  bool LoadTT(const std::string& file_name) { return TT.Load(file_name); }
+
+  // See `TranspositionTable::Statistics`.
+  TTStatistics TTStats(long long max_samples) {
+    return TT.Statistics(max_samples);
   }
 
   // Evaluates situation `sit_` with the Negamax algorithm, exploring `depth`
   // moves ahead. Higher is better for the player to move.
   int NegamaxEval(int depth, int alpha, int beta) {
+    if (--nodes_until_time_poll_ == 0) {
+      nodes_until_time_poll_ = TimeManager::kPollIntervalNodes;
+      OutOfTime();
+    }
+    // The return value of an aborted search is meaningless, so nothing is
+    // stored in the TT after an abort.
+    if (IsAborted()) return 0;
     if (sit_.IsGameOver()) {
       METRIC_INC(num_exits[depth][GAME_OVER_EXIT]);
       // Adding `depth` to winning positions makes the AI choose moves that
@@ -89,15 +652,36 @@ class Negamax {
     }
     if (depth == 0) {
       METRIC_INC(num_exits[depth][LEAF_EVAL_EXIT]);
+      if (quiescence_search_) {
+        quiescence_nodes_left_ = kQuiescenceNodeBudget;
+        return QuiescenceEval(alpha, beta);
+      }
       return (sit_.turn == 0 ? 1 : -1) * LeafEval();
     }
 
     // Read from TT.
     int starting_alpha = alpha;
-    std::size_t tt_location = TT.Location(sit_);
-    TTEntry<R, C>& tt_entry = TT.Entry(tt_location);
-    bool found_tt_entry = TT.Contains(tt_location, sit_);
-    if (found_tt_entry && tt_entry.depth >= depth) {
+    const TTKey tt_key = CurrentTTKey();
+    TTEntry<R, C> tt_entry;
+    bool found_tt_entry =
+        TT.Probe(tt_key.location, sit_, tt_key.mirrored, tt_entry);
+    METRIC_INC(tt_probes[depth]);
+    if (found_tt_entry) {
+      METRIC_INC(tt_found_reads[depth]);
+      if (tt_entry.mirrored != tt_key.mirrored) {
+        METRIC_INC(tt_mirrored_reads[depth]);
+      }
+    } else if (!TT.IsEmpty(tt_key.location)) {
+      METRIC_INC(tt_collision_reads[depth]);
+    }
+    // The eval of an entry computed for the mirror image of `sit_` can only be
+    // used if the draw rule cannot apply within its depth. The cached move can
+    // always be used. At the root, the eval is not used so that the search
+    // runs and sets `root_move_`.
+    const bool is_root = depth == ID_depth;
+    if (!is_root && found_tt_entry && tt_entry.depth >= depth &&
+        (tt_entry.mirrored == tt_key.mirrored ||
+         IsMirrorSafe(tt_entry.depth))) {
       assert(tt_entry.alpha_beta_flag != kEmptyEntry);
       if (tt_entry.alpha_beta_flag == kExactFlag) {
         METRIC_INC(num_exits[depth][TT_HIT_EXIT]);
@@ -123,25 +707,94 @@ class Negamax {
       }
     }
 
+    // A race is solved without searching it. At the root, `IterativeDeepening`
+    // already checked. A race whose eval differs in the mirror image is
+    // searched instead if the TT entries of its ancestors may be shared with
+    // their mirror images, since they would depend on it.
+    if (race_solver_ && !is_root) {
+      int race_eval;
+      bool race_mirror_safe;
+      if (SolveRace(depth, race_eval, nullptr, &race_mirror_safe) &&
+          (race_mirror_safe || !SharesMirrorEntries())) {
+        METRIC_INC(race_solves);
+        METRIC_INC(num_exits[depth][GAME_OVER_EXIT]);
+        return race_eval;
+      }
+    }
+
+    if (futility_pruning_ && !is_root && beta == alpha + 1 && depth <= 2 &&
+        std::abs(alpha) < kGameOverEval) {
+      const int eval = FutilityEval(depth, alpha);
+      if (eval <= alpha) return eval;
+    }
+
+    if (null_move_pruning_ && !is_root && beta == alpha + 1 &&
+        depth >= kNullMoveMinDepth && std::abs(beta) < kGameOverEval &&
+        moves_to_ply_[ply_] != kNullMove && IsNullMoveCandidate(beta)) {
+      METRIC_INC(null_move_searches);
+      moves_to_ply_[ply_ + 1] = kNullMove;
+      PassTurn();
+      ++ply_;
+      const int eval =
+          -NegamaxEval(depth - 1 - kNullMoveReduction, -beta, -beta + 1);
+      --ply_;
+      PassTurn();
+      if (IsAborted()) return 0;
+      // The eval is not exact, so a win found by the search with the free
+      // move is not returned as such.
+      if (eval >= beta) {
+        METRIC_INC(null_move_cutoffs);
+        return beta;
+      }
+    }
+
     ScoredMove best_move;
     // `best_move_eval` is initialized to -2*kGameOverEval so that *some* move
     // is still chosen in the event that every move is losing, which are
     // evaluated to -kGameOverEval.
     best_move.score = -2 * kGameOverEval;
 
+    // Number of children searched so far. See `kYBWCMinSplitDepth`.
+    int num_searched_children = 0;
+    const int ply = ply_;
+    // Moves searched before generating moves, which are not searched again.
+    std::array<Move, 2> searched_moves{};
+
     // Before generating moves, try the cached move, if any. This can cause an
     // instant cut-off or improve the alpha.
-    Move cached_move{tt_entry.token_change, {tt_entry.edge0, tt_entry.edge1}};
-    if (found_tt_entry && sit_.IsLegalMove(cached_move)) {
+    Move cached_move = MoveInTTEntry(tt_entry, tt_key);
+    bool has_cached_move = found_tt_entry && sit_.IsLegalMove(cached_move);
+    // Without a cached move, internal iterative deepening finds one. The
+    // shallower search may not store an entry, e.g., if it solves a race.
+    bool cached_move_from_iid = false;
+    if (internal_iterative_deepening_ && !is_root && !has_cached_move &&
+        depth >= kIIDMinDepth) {
+      METRIC_INC(iid_searches);
+      NegamaxEval(depth - kIIDReduction, alpha, beta);
+      if (IsAborted()) return 0;
+      if (TT.Probe(tt_key.location, sit_, tt_key.mirrored, tt_entry)) {
+        cached_move = MoveInTTEntry(tt_entry, tt_key);
+        has_cached_move = sit_.IsLegalMove(cached_move);
+        cached_move_from_iid = has_cached_move;
+      }
+    }
+    if (has_cached_move && !IsExcludedRootMove(cached_move)) {
+      ++num_searched_children;
+      searched_moves[0] = cached_move;
       best_move.move = cached_move;
-      sit_.ApplyMove(cached_move);
-      int eval = -NegamaxEval(depth - 1, -beta, -alpha);
-      sit_.UndoMove(cached_move);
+      int eval = ChildEval(cached_move, depth, alpha, beta,
+                           /*null_window=*/false);
+      if (IsAborted()) return 0;
       alpha = std::max(alpha, eval);
       // METRIC_INC(num_exits[depth][LEAF_EVAL_EXIT]);
       if (alpha >= beta) {
-        UpdateTTEntry(found_tt_entry, tt_location, tt_entry, depth, cached_move,
-                      eval, starting_alpha, beta);
+        METRIC_INC(cutoff_moves[depth][TT_MOVE_CUTOFF]);
+        if (cached_move_from_iid) {
+          METRIC_INC(iid_move_cutoffs);
+        }
+        RecordCutoff(cached_move, depth, ply);
+        UpdateTTEntry(tt_key, depth, cached_move, eval, starting_alpha, beta);
+        if (is_root) SetRootResult(cached_move, eval);
         return eval;
       } else {
         best_move.move = cached_move;
@@ -152,14 +805,20 @@ class Negamax {
     // Before generating moves, try a double-walk move to see if it causes a
     // beta-cutoff or improves alpha.
     Move double_walk_move = GetDoubleWalkMove();
-    if (sit_.IsLegalMove(double_walk_move)) {
-      sit_.ApplyMove(double_walk_move);
-      int eval = -NegamaxEval(depth - 1, -beta, -alpha);
-      sit_.UndoMove(double_walk_move);
+    if (sit_.IsLegalMove(double_walk_move) &&
+        !IsExcludedRootMove(double_walk_move)) {
+      int eval = ChildEval(double_walk_move, depth, alpha, beta,
+                           /*null_window=*/num_searched_children > 0);
+      ++num_searched_children;
+      searched_moves[1] = double_walk_move;
+      if (IsAborted()) return 0;
       alpha = std::max(alpha, eval);
       if (alpha >= beta) {
-        UpdateTTEntry(found_tt_entry, tt_location, tt_entry, depth,
-                      double_walk_move, eval, starting_alpha, beta);
+        METRIC_INC(cutoff_moves[depth][DOUBLE_WALK_CUTOFF]);
+        RecordCutoff(double_walk_move, depth, ply);
+        UpdateTTEntry(tt_key, depth, double_walk_move, eval, starting_alpha,
+                      beta);
+        if (is_root) SetRootResult(double_walk_move, eval);
         return eval;
       } else if (eval > best_move.score) {
         best_move.move = double_walk_move;
@@ -167,57 +826,836 @@ class Negamax {
       }
     }
 
-    const auto& ordered_moves = OrderedMoves(depth - 1);
-    METRIC_ADD(generated_children[depth], ordered_moves.size());
-    for (const ScoredMove& scored_move : ordered_moves) {
+    StagedMoves staged_moves(*this, depth - 1, ply, searched_moves);
+    if (!is_root && depth >= etc_min_depth_) {
+      ScoredMove cutoff;
+      if (EnhancedTranspositionCutoff(staged_moves, depth, beta, cutoff)) {
+        METRIC_INC(num_exits[depth][TT_CUTOFF_EXIT]);
+        RecordCutoff(cutoff.move, depth, ply);
+        UpdateTTEntry(tt_key, depth, cutoff.move, cutoff.score,
+                      starting_alpha, beta);
+        return cutoff.score;
+      }
+    }
+    // Children at depth 0 do not read the TT, so there is nothing to prefetch.
+    // `Peek` only generates the first stage, which the loop below needs
+    // anyway, so prefetching does not cause any extra move generation.
+    const bool prefetch_children = depth > 1;
+    if (prefetch_children) {
+      for (int i = 0; i < kTTPrefetchDistance; ++i) {
+        if (const ScoredMove* later_move = staged_moves.Peek(i))
+          PrefetchChild(later_move->move);
+      }
+    }
+    for (int i = 0; const ScoredMove* next_move = staged_moves.Get(i); ++i) {
+      if (pool_ != nullptr && depth >= kYBWCMinSplitDepth &&
+          num_searched_children > 0) {
+        SplitSearch(staged_moves.GetAllFrom(i), i, depth, is_root, alpha, beta,
+                    best_move);
+        if (IsAborted() && !RootOutOfTime(is_root)) return 0;
+        if (alpha >= beta) RecordCutoff(best_move.move, depth, ply);
+        break;
+      }
+      const ScoredMove& scored_move = *next_move;
       const Move& move = scored_move.move;
 
+      // While we search this move, the TT entry of a later one is loaded.
+      if (prefetch_children) {
+        if (const ScoredMove* later_move =
+                staged_moves.Peek(i + kTTPrefetchDistance))
+          PrefetchChild(later_move->move);
+      }
+
       // If it's a move that we haven't validated yet, we need to check if it is
       // legal.
       if (scored_move.score == kPossiblyIllegalMoveScore &&
           !sit_.IsLegalMove(move)) {
         continue;
       }
+      if (IsExcludedRootMove(move)) continue;
+
+      const bool null_window = num_searched_children > 0;
+      int move_eval =
+          ChildEval(move, depth, alpha, beta, null_window,
+                    null_window ? LateMoveReduction(depth, i, scored_move) : 0);
+      if (IsAborted()) {
+        if (RootOutOfTime(is_root)) break;
+        return 0;
+      }
+      ++num_searched_children;
 
-      sit_.ApplyMove(move);
-      int move_eval = -NegamaxEval(depth - 1, -beta, -alpha);
-      sit_.UndoMove(move);
-
-      if (move_eval > alpha) {
-        alpha = move_eval;
+      // The best score is tracked even below `alpha`, so that a fail-low
+      // stores the tightest upper bound rather than an understated one.
+      if (move_eval > best_move.score) {
         best_move.score = move_eval;
         best_move.move = move;
-        if (alpha >= beta) break;
+      }
+      if (move_eval > alpha) {
+        alpha = move_eval;
+        if (alpha >= beta) {
+          METRIC_INC(cutoff_moves[depth][CutoffMoveType(i)]);
+          METRIC_ADD(cutoff_index_sum[depth], i);
+          RecordCutoff(move, depth, ply);
+          break;
+        }
       }
 
-      // Only do this check at the shallowest level, and after the first ID
-      // iteration. For the first ID iteration (depth 1) we want to finish to
-      // ensure we have at least a move.
-      if (ID_depth > 1 && depth == ID_depth &&
-          MillisSince(search_start_timestamp) > search_millis) {
-        std::cout << "Did not finish search at depth " << ID_depth << std::endl;
+      // Besides the polling every `TimeManager::kPollIntervalNodes` nodes,
+      // the time is checked after each root move.
+      if (is_root && OutOfTime() && RootOutOfTime(is_root)) break;
+    }
+    METRIC_ADD(generated_children[depth], staged_moves.NumGenerated());
+
+    // If the search at the root was interrupted, the result is not as reliable
+    // as a full search at `depth`, but we still store it since its best move is
+    // a good first move to try in later searches. We label it with the depth
+    // of the previous (completed) iteration so that later searches, possibly
+    // warm-started from a TT snapshot, do not mistake it for a completed one.
+    UpdateTTEntry(tt_key, search_interrupted ? depth - 1 : depth,
+                  best_move.move, best_move.score, starting_alpha, beta);
+    if (is_root) SetRootResult(best_move.move, best_move.score);
+    METRIC_INC(num_exits[depth][REC_EVAL_EXIT]);
+    return best_move.score;
+  }
+
+  class StagedMoves;  // Defined below.
+
+  // Reads the TT entries of the children reached by the first `etc_max_moves_`
+  // moves of `staged_moves`, from a node at `depth`. If one of them is an
+  // exact eval or an upper bound, from a search at depth at least `depth` - 1,
+  // which is at most -`beta`, sets `cutoff` to its move and to the eval that it
+  // proves for the node, and returns true. Only entries stored in the same
+  // orientation as the child are used, since checking whether a mirrored one
+  // applies (see `IsMirrorSafe`) costs two BFS. Deferred moves, which may be
+  // illegal, are not considered.
+  bool EnhancedTranspositionCutoff(StagedMoves& staged_moves, int depth,
+                                   int beta, ScoredMove& cutoff) {
+    for (int i = 0; i < etc_max_moves_; ++i) {
+      const ScoredMove* scored_move = staged_moves.Get(i);
+      if (scored_move == nullptr ||
+          scored_move->score == kPossiblyIllegalMoveScore)
+        return false;
+      const Move move = scored_move->move;
+      METRIC_INC(etc_probes);
+      ApplyMove(move);
+      const TTKey child_key = CurrentTTKey();
+      TTEntry<R, C> child_entry;
+      const bool refutes =
+          TT.Probe(child_key.location, sit_, child_key.mirrored,
+                   child_entry) &&
+          child_entry.mirrored == child_key.mirrored &&
+          child_entry.depth >= depth - 1 &&
+          child_entry.alpha_beta_flag != kLowerboundFlag &&
+          -child_entry.eval >= beta;
+      const int eval = -child_entry.eval;
+      UndoMove(move);
+      if (refutes) {
+        METRIC_INC(etc_cutoffs);
+        cutoff.move = move;
+        cutoff.score = eval;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Whether null-move pruning applies to `sit_` with `beta`, apart from the
+  // conditions on the node. See `kNullMoveMinDepth`.
+  bool IsNullMoveCandidate(int beta) {
+    const std::array<int, 2> goal_distances = GoalDistances();
+    const int dist = goal_distances[sit_.turn];
+    const int opp_dist = goal_distances[1 - sit_.turn];
+    if (dist <= 2 || opp_dist <= 2 || opp_dist - dist < beta) return false;
+    return CanBuildWall();
+  }
+
+  // Whether the player to move can build a wall in `sit_`, i.e., whether some
+  // edge is not a bridge.
+  bool CanBuildWall() const {
+    return (sit_.G.edges & ~sit_.G.Bridges()).any();
+  }
+
+  // Passes the turn in `sit_`, or takes back a pass, and updates `sit_hash_`,
+  // `sit_mirror_hash_`, and the NNUE accumulator. Passing is not a legal move,
+  // so it does not go through `Situation::ApplyMove`.
+  inline void PassTurn() {
+    sit_hash_ ^= kZobristKeys<R, C>.turn;
+    if (kMirrorCanonicalization)
+      sit_mirror_hash_ ^= kMirroredZobristKeys<R, C>.turn;
+    // The update for a move without actions only changes the turn feature.
+    if (nnue_ != nullptr)
+      nnue_->UpdateForMove(sit_, kNullMove, nnue_accumulator_, false);
+    sit_.FlipTurn();
+  }
+
+  // Returns the eval of the child reached by `move` from a node at `depth` with
+  // window [`alpha`, `beta`]. With `null_window`, i.e., for children after the
+  // first (principal variation search), the child is first searched with the
+  // null window [`alpha`, `alpha`+1], which only tells whether it improves
+  // `alpha`. This is cheaper because, with good move ordering, it usually does
+  // not. If it does, the child is searched again with the full window.
+  // With a `reduction`, which requires `null_window`, the null-window search is
+  // first done `reduction` plies shallower, and repeated at full depth only if
+  // it does not fail low (see `kLMRMinDepth`).
+  int ChildEval(const Move& move, int depth, int alpha, int beta,
+                bool null_window, int reduction = 0) {
+    moves_to_ply_[ply_ + 1] = move;
+    ApplyMove(move);
+    ++ply_;
+    int eval;
+    if (reduction > 0) {
+      METRIC_INC(lmr_reductions[depth]);
+      eval = -NegamaxEval(depth - 1 - reduction, -alpha - 1, -alpha);
+      if (eval <= alpha || IsAborted()) {
+        --ply_;
+        UndoMove(move);
+        return eval;
+      }
+      METRIC_INC(lmr_researches[depth]);
+    }
+    if (null_window && beta > alpha + 1) {
+      eval = -NegamaxEval(depth - 1, -alpha - 1, -alpha);
+      if (eval > alpha && eval < beta && !IsAborted()) {
+        METRIC_INC(pvs_researches[depth]);
+        eval = -NegamaxEval(depth - 1, -beta, -alpha);
+      }
+    } else {
+      eval = -NegamaxEval(depth - 1, -beta, -alpha);
+    }
+    --ply_;
+    UndoMove(move);
+    return eval;
+  }
+
+  // The reduction of the search depth of the move `scored_move` at index
+  // `index` of the `StagedMoves` of a node at `depth`. See `kLMRMinDepth`.
+  int LateMoveReduction(int depth, std::size_t index,
+                        const ScoredMove& scored_move) const {
+    if (!late_move_reductions_ || depth < kLMRMinDepth) return 0;
+    int reduction = 0;
+    if (index >= kLMRMinMoveIndex) ++reduction;
+    if (scored_move.score <= kLMRWeakMoveScore) ++reduction;
+    // The reduced search is at least at depth 1.
+    return std::min(reduction, depth - 2);
+  }
+
+  static CutoffMoves CutoffMoveType(std::size_t index) {
+    if (index < 3) return static_cast<CutoffMoves>(FIRST_MOVE_CUTOFF + index);
+    return index < 8 ? EARLY_MOVE_CUTOFF : LATE_MOVE_CUTOFF;
+  }
+
+  // Updates the move-ordering heuristics after `move` caused a beta cutoff at a
+  // node at `depth` and `ply`.
+  void RecordCutoff(const Move& move, int depth, int ply) {
+    MoveOrderingTables& tables = *tables_;
+    std::array<Move, 2>& killers = tables.killers[ply];
+    if (killers[0] != move) {
+      killers[1] = killers[0];
+      killers[0] = move;
+    }
+    const int turn = sit_.turn;
+    if (ply > 0) {
+      tables.countermoves[turn][CountermoveIndex(moves_to_ply_[ply])] = move;
+    }
+    // Deeper cutoffs save more work, so they weigh more.
+    const int bonus = depth * depth;
+    bool needs_aging = false;
+    if (move.token_change != 0) {
+      int& history = tables.walk_history[turn][move.token_change + 2 * C];
+      history += bonus;
+      needs_aging |= history > kMaxHistory;
+    }
+    for (int edge : move.edges) {
+      if (edge == -1) continue;
+      int& history = tables.wall_history[turn][edge];
+      history += bonus;
+      needs_aging |= history > kMaxHistory;
+    }
+    if (needs_aging) AgeHistory();
+  }
+
+  // Moves the killers of each ply `num_plies` plies closer to the root, or
+  // clears them if `num_plies` is negative.
+  void ShiftKillers(int num_plies) {
+    auto& killers = tables_->killers;
+    for (int ply = 0; ply < kMaxDepth + 1; ++ply) {
+      const int old_ply = ply + num_plies;
+      const bool shared = num_plies >= 0 && old_ply < kMaxDepth + 1;
+      killers[ply] = shared ? killers[old_ply] : std::array<Move, 2>{};
+    }
+  }
+
+  // Returns the first iterative-deepening depth for the root, `sit_`: one more
+  // than the depth of its TT entry if the entry has a legal move, which
+  // becomes the root result until an iteration improves it. Otherwise, returns
+  // 1. The eval may only be a bound, e.g., after an aspiration re-search, but
+  // it only centers the first aspiration window. Game-over evals are not
+  // reused, since they depend on the depth where they were found.
+  int ResumeDepth(int max_depth) {
+    const TTKey tt_key = CurrentTTKey();
+    TTEntry<R, C> tt_entry;
+    if (!TT.Probe(tt_key.location, sit_, tt_key.mirrored, tt_entry)) return 1;
+    const Move move = MoveInTTEntry(tt_entry, tt_key);
+    if (!sit_.IsLegalMove(move) || std::abs(tt_entry.eval) >= kGameOverEval ||
+        (tt_entry.mirrored != tt_key.mirrored &&
+         !IsMirrorSafe(tt_entry.depth)))
+      return 1;
+    SetRootResult(move, tt_entry.eval);
+    METRIC_SET(max_completed_depth, tt_entry.depth);
+    return std::min(tt_entry.depth + 1, max_depth);
+  }
+
+  void AgeHistory() {
+    for (auto& player_history : tables_->wall_history)
+      for (int& history : player_history) history /= 2;
+    for (auto& player_history : tables_->walk_history)
+      for (int& history : player_history) history /= 2;
+  }
+
+  // Index of the entry of `move` in the countermove tables: the last wall it
+  // builds or, if it only walks, its token change.
+  static int CountermoveIndex(const Move& move) {
+    if (move.edges[1] != -1) return move.edges[1];
+    if (move.edges[0] != -1) return move.edges[0];
+    return NumRealAndFakeEdges(R, C) + move.token_change + 2 * C;
+  }
+
+  // Adds the bonuses of the move-ordering heuristics to the scores of `moves`,
+  // which are the moves of `sit_`, at ply `ply` of the search.
+  void AddHeuristicScores(nonstd::span<ScoredMove> moves, int ply) const {
+    const MoveOrderingTables& tables = *tables_;
+    const int turn = sit_.turn;
+    const std::array<Move, 2>& killers = tables.killers[ply];
+    // The root has no previous move.
+    const Move countermove =
+        ply > 0
+            ? tables.countermoves[turn][CountermoveIndex(moves_to_ply_[ply])]
+            : Move();
+    for (ScoredMove& scored_move : moves) {
+      // This score marks moves whose legality is not checked yet.
+      if (scored_move.score == kPossiblyIllegalMoveScore) continue;
+      const Move& move = scored_move.move;
+      if (move == killers[0]) {
+        scored_move.score += kFirstKillerBonus;
+      } else if (move == killers[1]) {
+        scored_move.score += kSecondKillerBonus;
+      }
+      if (move == countermove) scored_move.score += kCountermoveBonus;
+      int history = 0;
+      if (move.token_change != 0)
+        history += tables.walk_history[turn][move.token_change + 2 * C];
+      for (int edge : move.edges) {
+        if (edge != -1) history += tables.wall_history[turn][edge];
+      }
+      scored_move.score += history * kMaxHistoryBonus / kMaxHistory;
+    }
+  }
+
+  void SetRootResult(const Move& move, int eval) {
+    root_move_ = move;
+    root_eval_ = eval;
+  }
+
+  // Sets `sit_` and its hashes.
+  void SetRootSituation(const Situation<R, C>& sit) {
+    sit_ = sit;
+    sit_hash_ = SituationHash(sit_);
+    sit_mirror_hash_ = SituationMirrorHash(sit_);
+    if (nnue_ != nullptr) nnue_->Refresh(sit_, nnue_accumulator_);
+  }
+
+  // Runs the iterative-deepening search of `sit` up to depth `max_depth`, or
+  // until the time manager stops it, and sets `root_move_`.
+  void IterativeDeepening(const Situation<R, C>& sit, int max_depth) {
+    SetRootSituation(sit);
+    TT.NewSearch();
+    // Killers are specific to the plies of a search, so they are only kept,
+    // shifted, if the root advanced along the last search. Older history is
+    // less relevant, but still useful.
+    ShiftKillers(root_advance_);
+    root_advance_ = -1;
+    AgeHistory();
+    // Multi-PV rankings always start from depth 1.
+    const int first_depth =
+        resume_from_TT_ && num_pvs_ == 0 ? ResumeDepth(max_depth) : 1;
+
+    // A race has an exact answer without a search. See `SolveRace`.
+    Move race_move;
+    int race_eval;
+    if (race_solver_ && num_pvs_ == 0 && SolveRace(0, race_eval, &race_move)) {
+      SetRootResult(race_move, race_eval);
+      METRIC_INC(race_solves);
+      if (!time_manager_->Pondering()) {
+        std::cout << "Solved race: " << sit.MoveToStandardNotation(race_move)
+                  << " (eval: " << race_eval << ")" << std::endl;
+      }
+      return;
+    }
+
+    std::atomic<bool> stop_helpers{false};
+    std::vector<std::thread> helpers;
+    if (parallel_mode_ == ParallelMode::kLazySMP) {
+      for (int i = 1; i < num_threads_; ++i) {
+        helpers.emplace_back([this, sit, i, &stop_helpers]() {
+          Negamax helper(TT, eval_cache_, stop_helpers, i);
+          helper.late_move_reductions_ = late_move_reductions_;
+          helper.futility_pruning_ = futility_pruning_;
+          helper.etc_min_depth_ = etc_min_depth_;
+          helper.etc_max_moves_ = etc_max_moves_;
+          helper.internal_iterative_deepening_ =
+              internal_iterative_deepening_;
+          helper.null_move_pruning_ = null_move_pruning_;
+          helper.quiescence_search_ = quiescence_search_;
+          helper.race_solver_ = race_solver_;
+          helper.eval_cache_enabled_ = eval_cache_enabled_;
+          helper.nnue_ = nnue_;
+          helper.HelperSearch(sit, i);
+        });
+      }
+    }
+    // Each thread of the pool adds its metrics to `pool_metrics` when the pool
+    // is destroyed.
+    std::unique_ptr<WorkStealingPool> pool;
+    std::mutex pool_metrics_mutex;
+    BenchmarkMetrics pool_metrics = {};
+    if (parallel_mode_ == ParallelMode::kYBWC && num_threads_ > 1) {
+      pool = std::make_unique<WorkStealingPool>(num_threads_, [&]() {
+        std::lock_guard<std::mutex> lock(pool_metrics_mutex);
+        pool_metrics.Add(global_metrics);
+      });
+      pool_ = pool.get();
+    }
+
+    for (ID_depth = first_depth; ID_depth <= max_depth; ++ID_depth) {
+      // The ponder search only prints after a ponder hit, not while the
+      // opponent thinks.
+      const bool verbose = !time_manager_->Pondering();
+      if (verbose) {
+        std::cout << "Search depth " << ID_depth << " with "
+                  << time_manager_->SoftMillisLeft() << " millis left."
+                  << std::endl;
+      }
+      const Move prev_iteration_move = root_move_;
+
+      // The search store the best move in the TT.
+      if (num_pvs_ > 0) {
+        MultiPVRootSearch();
+      } else {
+        RootSearch();
+      }
+      if (!search_interrupted) {
+        METRIC_SET(completed_depth_millis[ID_depth],
+                   time_manager_->ElapsedMillis());
+        METRIC_SET(max_completed_depth, ID_depth);
+      }
+
+      if (verbose) {
+        std::cout << "Best move: " << sit.MoveToStandardNotation(root_move_)
+                  << " (eval: " << root_eval_ << ")" << std::endl;
+      }
+
+      if (root_eval_ >= kGameOverEval && RankedMovesAreDecided()) {
+        if (verbose) {
+          std::cout << "Found winning move at depth " << ID_depth << "."
+                    << std::endl;
+        }
         break;
       }
+      if (root_eval_ <= -kGameOverEval) {
+        if (verbose) {
+          std::cout << "Position is lost at depth " << ID_depth << "."
+                    << std::endl;
+        }
+        break;
+      }
+      if (!time_manager_->StartNextIteration(root_move_ !=
+                                             prev_iteration_move))
+        break;
     }
 
-    UpdateTTEntry(found_tt_entry, tt_location, tt_entry, depth, best_move.move,
-                  best_move.score, starting_alpha, beta);
-    METRIC_INC(num_exits[depth][REC_EVAL_EXIT]);
-    return best_move.score;
+    stop_helpers = true;
+    for (std::thread& helper : helpers) helper.join();
+    if (pool != nullptr) {
+      pool.reset();
+      pool_ = nullptr;
+      if (kBenchmark) global_metrics.Add(pool_metrics);
+    }
+  }
+
+  // Searches the root at depth `ID_depth` with the root algorithm.
+  void RootSearch() {
+    if (root_algorithm_ == RootAlgorithm::kMTDf) {
+      MTDfRootSearch();
+    } else {
+      AspirationRootSearch();
+    }
+  }
+
+  // Ranks the best `num_pvs_` root moves at depth `ID_depth` into
+  // `ranked_moves_`, with one root search per move. Each search skips the
+  // moves ranked before it and starts from the eval of the move with the same
+  // rank at the previous depth. If the time runs out, `ranked_moves_` keeps the
+  // ranking of the previous depth, which is empty if it runs out at depth 1
+  // (see `SearchRoot`). The root result is the best move, if there is one.
+  void MultiPVRootSearch() {
+    std::vector<RankedMove> ranked_moves;
+    for (int i = 0; i < num_pvs_; ++i) {
+      if (i < static_cast<int>(ranked_moves_.size())) {
+        SetRootResult(ranked_moves_[i].move, ranked_moves_[i].eval);
+      } else {
+        SetRootResult(Move(), 0);
+      }
+      RootSearch();
+      // Without legal moves left, the search does not find any move.
+      if (search_interrupted || !sit_.IsLegalMove(root_move_) ||
+          root_eval_ <= -2 * kGameOverEval)
+        break;
+      ranked_moves.push_back(
+          {root_move_, root_eval_, PrincipalVariation(root_move_)});
+      excluded_root_moves_.push_back(root_move_);
+    }
+    excluded_root_moves_.clear();
+    if (!search_interrupted) ranked_moves_ = std::move(ranked_moves);
+    if (!ranked_moves_.empty())
+      SetRootResult(ranked_moves_[0].move, ranked_moves_[0].eval);
+  }
+
+  // Whether the eval of every ranked move is a game-over eval, which deeper
+  // searches do not change. Always true without multi-PV.
+  bool RankedMovesAreDecided() const {
+    return std::all_of(ranked_moves_.begin(), ranked_moves_.end(),
+                       [](const RankedMove& ranked_move) {
+                         return std::abs(ranked_move.eval) >= kGameOverEval;
+                       });
+  }
+
+  // Whether `move` is a root move that the current multi-PV pass skips.
+  inline bool IsExcludedRootMove(const Move& move) const {
+    return ply_ == 0 && !excluded_root_moves_.empty() &&
+           std::find(excluded_root_moves_.begin(), excluded_root_moves_.end(),
+                     move) != excluded_root_moves_.end();
+  }
+
+  // Returns the principal variation of the root move `move`: `move` followed
+  // by the moves cached in the TT, up to `ID_depth` moves in total. It stops
+  // early where an entry was overwritten, and later moves may come from
+  // shallower searches.
+  std::vector<Move> PrincipalVariation(const Move& move) {
+    std::vector<Move> pv = {move};
+    ApplyMove(move);
+    while (static_cast<int>(pv.size()) < ID_depth && !sit_.IsGameOver()) {
+      const TTKey tt_key = CurrentTTKey();
+      TTEntry<R, C> tt_entry;
+      if (!TT.Probe(tt_key.location, sit_, tt_key.mirrored, tt_entry)) break;
+      const Move next_move = MoveInTTEntry(tt_entry, tt_key);
+      if (!sit_.IsLegalMove(next_move)) break;
+      pv.push_back(next_move);
+      ApplyMove(next_move);
+    }
+    for (auto it = pv.rbegin(); it != pv.rend(); ++it) UndoMove(*it);
+    return pv;
+  }
+
+  // Searches the root at depth `ID_depth` with window [`alpha`, `beta`]. Sets
+  // `search_interrupted` if it runs out of time, even before any root move is
+  // searched.
+  void SearchRoot(int alpha, int beta) {
+    search_interrupted = false;
+    NegamaxEval(ID_depth, alpha, beta);
+    if (time_manager_->Stopped()) search_interrupted = true;
+  }
+
+  // Searches the root at depth `ID_depth` with an aspiration window. See
+  // `SetRootAlgorithm`.
+  void AspirationRootSearch() {
+    int alpha = -2 * kGameOverEval;
+    int beta = 2 * kGameOverEval;
+    // Aspiration window: the eval is likely close to the one of the previous
+    // iteration, and a narrower window prunes more.
+    int window = kAspirationWindow;
+    const Move prev_root_move = root_move_;
+    if (ID_depth > 1 && std::abs(root_eval_) < kGameOverEval) {
+      alpha = root_eval_ - window;
+      beta = root_eval_ + window;
+    }
+    while (true) {
+      SearchRoot(alpha, beta);
+      if (search_interrupted) break;
+      // On a fail low or fail high, the eval is only a bound, so the search
+      // is repeated with a wider window.
+      if (root_eval_ <= alpha && alpha > -2 * kGameOverEval) {
+        alpha = std::max(alpha - window, -2 * kGameOverEval);
+      } else if (root_eval_ >= beta && beta < 2 * kGameOverEval) {
+        beta = std::min(beta + window, 2 * kGameOverEval);
+      } else {
+        break;
+      }
+      window *= 2;
+      METRIC_INC(aspiration_researches);
+    }
+    // If a search that failed low was interrupted, every move it searched is
+    // worse than expected, so the previous best move is kept.
+    if (search_interrupted && root_eval_ <= alpha) {
+      root_move_ = prev_root_move;
+    }
+  }
+
+  // Searches the root at depth `ID_depth` with MTD(f). See `SetRootAlgorithm`.
+  // Each null-window search returns a bound of the eval: a lower bound if it
+  // fails high and an upper bound if it fails low. The search stops when the
+  // bounds meet.
+  void MTDfRootSearch() {
+    const Move prev_root_move = root_move_;
+    int guess = ID_depth > 1 ? root_eval_ : 0;
+    int lowerbound = -2 * kGameOverEval;
+    int upperbound = 2 * kGameOverEval;
+    // After a fail low, `root_move_` is only the least bad move found, so the
+    // result is the move of the last search that failed high.
+    Move best_move = prev_root_move;
+    while (lowerbound < upperbound) {
+      const int beta = guess == lowerbound ? guess + 1 : guess;
+      SearchRoot(beta - 1, beta);
+      METRIC_INC(mtdf_searches);
+      if (search_interrupted) break;
+      guess = root_eval_;
+      if (guess < beta) {
+        upperbound = guess;
+      } else {
+        lowerbound = guess;
+        best_move = root_move_;
+      }
+    }
+    // Without a fail high, the lower bound is still the initial one.
+    if (lowerbound > -2 * kGameOverEval) {
+      SetRootResult(best_move, lowerbound);
+    } else if (ID_depth > 1) {
+      root_move_ = prev_root_move;
+    }
+  }
+
+  // Iterative-deepening loop of a Lazy SMP helper with index `helper_index`
+  // (starting at 1). Half of the helpers search one depth ahead of the others
+  // so that the TT gets deeper results sooner. The helper runs until `stop_` is
+  // set.
+  void HelperSearch(const Situation<R, C>& sit, int helper_index) {
+    time_manager_->Start(TimeLimits());
+    SetRootSituation(sit);
+    for (ID_depth = 1 + helper_index % 2; ID_depth < kMaxDepth && !IsAborted();
+         ++ID_depth) {
+      search_interrupted = false;
+      NegamaxEval(ID_depth, -2 * kGameOverEval, 2 * kGameOverEval);
+    }
+  }
+
+  // Polls the time manager and returns whether the search ran out of time. The
+  // first iteration never runs out of time, so that there is a move.
+  bool OutOfTime() {
+    if (ID_depth == 1) return false;
+    time_manager_->Poll();
+    return time_manager_->Stopped();
+  }
+
+  // Returns whether the search is at the root and ran out of time. Then, the
+  // moves searched so far are kept, as in an interrupted search, instead of
+  // discarding the search like other aborted searches.
+  bool RootOutOfTime(bool is_root) {
+    if (!is_root || !time_manager_->Stopped()) return false;
+    if (!search_interrupted && !time_manager_->Pondering()) {
+      std::cout << "Did not finish search at depth " << ID_depth << std::endl;
+    }
+    search_interrupted = true;
+    return true;
   }
 
-  inline void UpdateTTEntry(bool found_tt_entry, std::size_t tt_location,
-                            TTEntry<R, C>& tt_entry, int depth, Move move,
+  // A search is aborted when it runs out of time, when the Lazy SMP helpers
+  // are stopped or, for YBWC tasks, when a sibling of the task or of one of its
+  // ancestors caused a beta cutoff.
+  inline bool IsAborted() const {
+    if (time_manager_->Stopped()) return true;
+    if (stop_ != nullptr && stop_->load(std::memory_order_relaxed)) return true;
+    for (const SplitPoint* sp = split_point_; sp != nullptr; sp = sp->parent) {
+      if (sp->cutoff.load(std::memory_order_relaxed)) return true;
+    }
+    return false;
+  }
+
+  // Searches the children of `sit_` reached by `moves` as tasks of `pool_`,
+  // and updates `alpha` and `best_move` like the sequential loop in
+  // `NegamaxEval`. The calling thread runs the tasks that are not stolen.
+  // `first_index` is the index of `moves[0]` in the list of ordered moves.
+  void SplitSearch(nonstd::span<const ScoredMove> moves,
+                   std::size_t first_index, int depth, bool is_root,
+                   int& alpha, int beta, ScoredMove& best_move) {
+    SplitPoint sp;
+    sp.parent = split_point_;
+    sp.depth = depth;
+    sp.beta = beta;
+    sp.is_root = is_root;
+    sp.alpha = alpha;
+    sp.best_move = best_move;
+    WorkStealingPool::TaskGroup group;
+    // The pool runs the tasks of a thread in LIFO order, so they are submitted
+    // from last to first for the best moves to be searched first.
+    for (std::size_t i = moves.size(); i-- > 0;) {
+      const ScoredMove scored_move = moves[i];
+      const std::size_t index = first_index + i;
+      pool_->Submit(group, [this, &sp, scored_move, index]() {
+        SearchSplitPointChild(sp, scored_move, index);
+      });
+    }
+    pool_->Wait(group);
+    if (sp.interrupted) {
+      if (!time_manager_->Pondering()) {
+        std::cout << "Did not finish search at depth " << ID_depth << std::endl;
+      }
+      search_interrupted = true;
+    }
+    alpha = sp.alpha;
+    best_move = sp.best_move;
+  }
+
+  // Runs in any thread of `pool_` while this searcher waits in `SplitSearch`,
+  // so `sit_` does not change.
+  void SearchSplitPointChild(SplitPoint& sp, const ScoredMove& scored_move,
+                             std::size_t index) {
+    if (sp.cutoff || IsAborted()) return;
+    // Same time check as in the sequential loop of `NegamaxEval`.
+    if (sp.is_root && OutOfTime()) {
+      sp.interrupted = true;
+      return;
+    }
+    const Move& move = scored_move.move;
+    if (scored_move.score == kPossiblyIllegalMoveScore &&
+        !sit_.IsLegalMove(move)) {
+      return;
+    }
+    if (IsExcludedRootMove(move)) return;
+    Negamax task_searcher(*this, sp);
+    // A split point always has a searched child, so the other children are
+    // searched with a null window first.
+    const int reduction = LateMoveReduction(sp.depth, index, scored_move);
+    const int eval = task_searcher.ChildEval(move, sp.depth, sp.alpha, sp.beta,
+                                             /*null_window=*/true, reduction);
+    if (task_searcher.IsAborted()) return;
+    std::lock_guard<std::mutex> lock(sp.mutex);
+    if (eval > sp.best_move.score) {
+      sp.best_move.score = eval;
+      sp.best_move.move = move;
+    }
+    if (eval > sp.alpha) {
+      sp.alpha = eval;
+      if (eval >= sp.beta) {
+        METRIC_INC(cutoff_moves[sp.depth][CutoffMoveType(index)]);
+        METRIC_ADD(cutoff_index_sum[sp.depth], index);
+        sp.cutoff = true;
+      }
+    }
+  }
+
+  // The move lists of YBWC task searchers are recycled within each thread.
+  static std::vector<std::unique_ptr<MoveLists>>& FreeMoveLists() {
+    thread_local std::vector<std::unique_ptr<MoveLists>> free_move_lists;
+    return free_move_lists;
+  }
+  static std::unique_ptr<MoveLists> AcquireMoveLists() {
+    auto& free_move_lists = FreeMoveLists();
+    if (free_move_lists.empty()) return std::make_unique<MoveLists>();
+    std::unique_ptr<MoveLists> move_lists = std::move(free_move_lists.back());
+    free_move_lists.pop_back();
+    return move_lists;
+  }
+  static void ReleaseMoveLists(std::unique_ptr<MoveLists> move_lists) {
+    FreeMoveLists().push_back(std::move(move_lists));
+  }
+
+  // Applies `move` to `sit_` and updates `sit_hash_`, `sit_mirror_hash_`, and
+  // the NNUE accumulator.
+  inline void ApplyMove(Move move) {
+    UpdateHashes(move);
+    if (nnue_ != nullptr)
+      nnue_->UpdateForMove(sit_, move, nnue_accumulator_, false);
+    sit_.ApplyMove(move);
+  }
+  // Undoes `move` in `sit_` and updates `sit_hash_`, `sit_mirror_hash_`, and
+  // the NNUE accumulator.
+  inline void UndoMove(Move move) {
+    sit_.UndoMove(move);
+    UpdateHashes(move);
+    if (nnue_ != nullptr)
+      nnue_->UpdateForMove(sit_, move, nnue_accumulator_, true);
+  }
+  inline void UpdateHashes(Move move) {
+    sit_hash_ ^= MoveHashDelta(sit_, move);
+    if (kMirrorCanonicalization)
+      sit_mirror_hash_ ^= MoveHashDelta(sit_, move, kMirroredZobristKeys<R, C>);
+  }
+
+  inline TTKey CurrentTTKey() {
+    if (SharesMirrorEntries() && sit_mirror_hash_ < sit_hash_)
+      return {TT.HashLocation(sit_mirror_hash_), true};
+    return {TT.HashLocation(sit_hash_), false};
+  }
+
+  // Whether a situation and its mirror image share their TT entry. The
+  // network is not mirror-symmetric, so with NNUE they do not: neither the
+  // eval nor the cached move, which may be one that `GenerateWalkMoves` prunes
+  // as useless in the situation, carries over.
+  inline bool SharesMirrorEntries() const {
+    return kMirrorCanonicalization && nnue_ == nullptr;
+  }
+
+  // Whether `sit_` and its mirror image have the same eval for searches of up
+  // to `depth` moves. This is the case if neither player can reach its goal
+  // within `depth` moves, since the draw rule is the only asymmetry, and there
+  // is no NNUE (see `SharesMirrorEntries`). The latter matters for entries
+  // stored by searchers without it in a shared TT. The quiescence search looks
+  // one more move ahead for each player at the leaves: it claims wins, and
+  // applies the draw rule, for a player within distance 2 of its goal.
+  inline bool IsMirrorSafe(int depth) const {
+    if (nnue_ != nullptr) return false;
+    const int turn = sit_.turn;
+    const int opp_turn = turn == 0 ? 1 : 0;
+    const int quiescence_moves = quiescence_search_ ? 1 : 0;
+    return sit_.G.Distance(sit_.tokens[turn], Goals(R, C)[turn]) >
+               2 * ((depth + 1) / 2 + quiescence_moves) &&
+           sit_.G.Distance(sit_.tokens[opp_turn], Goals(R, C)[opp_turn]) >
+               2 * (depth / 2 + quiescence_moves);
+  }
+
+  // Prefetches the TT entry of the child of `sit_` reached by `move`. Both
+  // orientations are prefetched since we do not know yet which one is
+  // canonical.
+  inline void PrefetchChild(Move move) {
+    TT.Prefetch(TT.HashLocation(sit_hash_ ^ MoveHashDelta(sit_, move)));
+    if (SharesMirrorEntries()) {
+      TT.Prefetch(TT.HashLocation(
+          sit_mirror_hash_ ^
+          MoveHashDelta(sit_, move, kMirroredZobristKeys<R, C>)));
+    }
+  }
+
+  inline void UpdateTTEntry(const TTKey& tt_key, int depth, Move move,
                             int eval, int starting_alpha, int beta) {
-    // Update TT. Current policy: always update or replace.
-    if (!found_tt_entry) {
-      tt_entry.sit = sit_;
-      if (TT.IsEmpty(tt_location)) {
+    // Update TT. Current policy: see `TranspositionTable::CanStore`. We check
+    // the entry again instead of relying on what we read at the start of the
+    // visit because the search of the children may have overwritten it.
+    // Multi-PV passes that skip moves do not find the eval of the root.
+    if (ply_ == 0 && !excluded_root_moves_.empty()) return;
+    if (!TT.CanStore(tt_key.location, sit_, depth, tt_key.mirrored)) {
+      METRIC_INC(tt_rejected_writes[depth]);
+      return;
+    }
+    if (!TT.ContainsUpToMirror(tt_key.location, sit_, tt_key.mirrored)) {
+      if (TT.IsEmpty(tt_key.location)) {
         METRIC_INC(tt_add_writes[depth]);
       } else {
         METRIC_INC(tt_replace_writes[depth]);
       }
     }
+    // If the entry was for the mirror image of `sit_`, it now switches to
+    // `sit_`.
+    TTEntry<R, C> tt_entry;
+    tt_entry.sit = sit_;
 
     if (eval <= starting_alpha)
       tt_entry.alpha_beta_flag = kUpperboundFlag;
@@ -231,13 +1669,401 @@ class Negamax {
     tt_entry.token_change = static_cast<int8_t>(move.token_change);
     tt_entry.edge0 = static_cast<int16_t>(move.edges[0]);
     tt_entry.edge1 = static_cast<int16_t>(move.edges[1]);
+    tt_entry.generation = TT.generation;
+    tt_entry.mirrored = tt_key.mirrored;
+    TT.Store(tt_key.location, tt_entry);
+  }
+
+  // Race solver: if the players are separated, i.e., in different connected
+  // components, and every edge of their shortest paths is a bridge, there is
+  // no other path to their goals, so no wall can lengthen them. The game is
+  // then a race, where walking along the shortest path is optimal, and the
+  // winner follows from the distances and the draw rule (see
+  // `Situation::Winner`). A player at an odd distance needs a move that walks
+  // one step and builds a wall, which can be any edge off both paths. To make
+  // sure that the players cannot run out of walls, e.g., by building them on
+  // purpose, the race is only solved if there are enough walls for every move
+  // until the end to build two.
+  //
+  // Returns whether `sit_` is such a race. If so, sets `eval` to its exact
+  // eval for a node at `depth` (see `NegamaxEval`), if `move` is not null,
+  // `*move` to a best move, and, if `mirror_safe` is not null, `*mirror_safe`
+  // to whether the mirror image of `sit_` has the same eval. A game that ends
+  // beyond `depth` gets the eval of a game over at depth 0.
+  //
+  // The eval of the mirror image differs if the draw rule decides the race,
+  // since the players swap, unless the game ends within `depth`: then the
+  // ancestors of the node do not share their TT entries with their mirror
+  // images (see `IsMirrorSafe`).
+  bool SolveRace(int depth, int& eval, Move* move = nullptr,
+                 bool* mirror_safe = nullptr) {
+    const std::array<int, 2> tokens = {sit_.tokens[0], sit_.tokens[1]};
+    if (sit_.G.Distance(tokens[0], tokens[1]) != -1) return false;
+    const std::array<std::array<int, NumNodes(R, C)>, 2> shortest_paths{
+        sit_.G.ShortestPath(tokens[0], Goals(R, C)[0]),
+        sit_.G.ShortestPath(tokens[1], Goals(R, C)[1])};
+    const std::array<std::bitset<NumRealAndFakeEdges(R, C)>, 2> SP_edges{
+        PathAsEdgeSet<R, C>(shortest_paths[0]),
+        PathAsEdgeSet<R, C>(shortest_paths[1])};
+    const std::bitset<NumRealAndFakeEdges(R, C)> path_edges =
+        SP_edges[0] | SP_edges[1];
+    if ((path_edges & ~sit_.G.Bridges()).any()) return false;
+    const std::array<int, 2> dists = {static_cast<int>(SP_edges[0].count()),
+                                      static_cast<int>(SP_edges[1].count())};
+    const std::array<int, 2> moves_left = {(dists[0] + 1) / 2,
+                                           (dists[1] + 1) / 2};
+    const std::bitset<NumRealAndFakeEdges(R, C)> free_walls =
+        sit_.G.edges & ~path_edges;
+    if (static_cast<int>(free_walls.count()) <
+        2 * (moves_left[0] + moves_left[1]))
+      return false;
+
+    // The player who needs fewer moves arrives first, or the player to move
+    // on a tie. The other player has made as many moves if it moved first,
+    // and one less otherwise. It gets a draw if it is P1 and it can still
+    // reach its goal with one more move.
+    const int turn = sit_.turn;
+    const int opp_turn = 1 - turn;
+    const int first =
+        moves_left[turn] <= moves_left[opp_turn] ? turn : opp_turn;
+    const int arrival_ply =
+        first == turn ? 2 * moves_left[turn] - 1 : 2 * moves_left[opp_turn];
+    const int second_moves =
+        first == turn ? moves_left[first] - 1 : moves_left[first];
+    const bool in_draw_range = dists[1 - first] - 2 * second_moves <= 2;
+    const bool draw = first == 0 && in_draw_range;
+    const int game_over_eval = kGameOverEval + std::max(depth - arrival_ply, 0);
+    eval = draw ? 0 : first == turn ? game_over_eval : -game_over_eval;
+    if (mirror_safe != nullptr)
+      *mirror_safe = !in_draw_range || arrival_ply <= depth;
+
+    if (move != nullptr) {
+      if (dists[turn] >= 2) {
+        *move = GetDoubleWalkMove();
+      } else {
+        int wall = 0;
+        while (!free_walls[wall]) ++wall;
+        *move = WalkAndBuildMove(tokens[turn], shortest_paths[turn][1], wall);
+      }
+    }
+    return true;
+  }
+
+  // Proof numbers of `sit_` for the player to move: `phi` is the proof number
+  // of its goal, which is the goal of the search for the attacker and keeping
+  // the attacker from it for the defender, and `delta` is the disproof number.
+  // With them, df-pn treats every node the same way.
+  struct MoverProofNumbers {
+    uint32_t phi;
+    uint32_t delta;
+  };
+
+  // Runs a df-pn search of `sit` for the goal of player `attacker`: winning,
+  // or, with `draw_is_success`, also a draw. Situations `max_plies` plies ahead
+  // that are not game over count as failures of the attacker. Returns whether
+  // the goal was proved. If it was by this search, and the attacker is to
+  // move, `dfpn_root_move_` is a move that achieves it.
+  bool ProveGoal(const Situation<R, C>& sit, int attacker, bool draw_is_success,
+                 int max_plies) {
+    if (dfpn_nodes_left_ <= 0) return false;
+    SetRootSituation(sit);
+    dfpn_root_move_ = Move();
+    dfpn_attacker_ = attacker;
+    dfpn_draw_is_success_ = draw_is_success;
+    dfpn_goal_ = 2 * draw_is_success + attacker;
+    dfpn_max_plies_ = max_plies;
+    const MoverProofNumbers numbers =
+        DfpnMID(0, kInfiniteProofNumber, kInfiniteProofNumber);
+    return (sit_.turn == attacker ? numbers.phi : numbers.delta) == 0;
   }
 
-  // Evaluates situation `sit_` with the formula dist(p1, g1) - dist(p0, g0).
-  // Higher is better for P0.
-  inline int LeafEval() const {
-    return sit_.G.Distance(sit_.tokens[1], Goals(R, C)[1]) -
-           sit_.G.Distance(sit_.tokens[0], Goals(R, C)[0]);
+  // The multiple iterative deepening (MID) step of df-pn: expands `sit_`, at
+  // `ply` plies from the root, until its `phi` reaches `phi_threshold` or its
+  // `delta` reaches `delta_threshold`, always going into the child with the
+  // smallest `delta`, i.e., the most promising move. The numbers are stored
+  // in the table, whose entries are reused by every later visit. The children
+  // are the moves of `OrderedMoves`, so that ties go to the best move.
+  MoverProofNumbers DfpnMID(int ply, uint32_t phi_threshold,
+                            uint32_t delta_threshold) {
+    const int plies_left = dfpn_max_plies_ - ply;
+    MoverProofNumbers numbers = LookupProofNumbers(plies_left);
+    if (numbers.phi >= phi_threshold || numbers.delta >= delta_threshold ||
+        dfpn_nodes_left_ <= 0)
+      return numbers;
+
+    // Terminal situations: game over, solved races, and the ply limit.
+    int winner = -1;
+    int race_eval;
+    if (sit_.IsGameOver()) {
+      winner = sit_.Winner();
+    } else if (race_solver_ && SolveRace(0, race_eval)) {
+      winner = race_eval == 0 ? 2 : race_eval > 0 ? sit_.turn : 1 - sit_.turn;
+    } else if (plies_left == 0 || !AttackerCanSucceed(plies_left)) {
+      winner = 1 - dfpn_attacker_;
+    }
+    if (winner != -1) {
+      const bool attacker_succeeds =
+          winner == dfpn_attacker_ || (winner == 2 && dfpn_draw_is_success_);
+      numbers = attacker_succeeds == (sit_.turn == dfpn_attacker_)
+                    ? MoverProofNumbers{0, kInfiniteProofNumber}
+                    : MoverProofNumbers{kInfiniteProofNumber, 0};
+      StoreProofNumbers(plies_left, numbers, 1);
+      return numbers;
+    }
+
+    --dfpn_nodes_left_;
+    const long long nodes_left_before = dfpn_nodes_left_;
+    // The numbers of the children are read from the table once, and then
+    // kept up to date with the results of their searches, so that entries
+    // overwritten in the meantime, e.g., by the same situation with a
+    // different number of plies left, are not searched again.
+    struct Child {
+      Move move;
+      MoverProofNumbers numbers;
+    };
+    std::vector<Child> children;
+    Child* best_child = nullptr;
+    for (const ScoredMove& scored_move : OrderedMoves(ply)) {
+      const Move& move = scored_move.move;
+      if (scored_move.score == kPossiblyIllegalMoveScore &&
+          !sit_.IsLegalMove(move))
+        continue;
+      const uint32_t rank = static_cast<uint32_t>(children.size());
+      ApplyMove(move);
+      children.push_back(
+          {move, LookupProofNumbers(plies_left - 1,
+                                    {1, 1 + rank / kDfpnMoveRankDivisor})});
+      UndoMove(move);
+    }
+    while (true) {
+      // `phi` is the smallest `delta` of the children, and `delta` is the sum
+      // of their `phi`s.
+      uint64_t phi_sum = 0;
+      uint32_t min_delta = kInfiniteProofNumber;
+      uint32_t second_min_delta = kInfiniteProofNumber;
+      for (Child& child : children) {
+        phi_sum = std::min<uint64_t>(phi_sum + child.numbers.phi,
+                                     kInfiniteProofNumber);
+        if (child.numbers.delta < min_delta) {
+          second_min_delta = min_delta;
+          min_delta = child.numbers.delta;
+          best_child = &child;
+        } else if (child.numbers.delta < second_min_delta) {
+          second_min_delta = child.numbers.delta;
+        }
+      }
+      numbers = {min_delta, static_cast<uint32_t>(phi_sum)};
+      if (numbers.phi >= phi_threshold || numbers.delta >= delta_threshold ||
+          dfpn_nodes_left_ <= 0)
+        break;
+
+      // The child is searched until its `delta` is no longer the smallest,
+      // with some slack (see `kDfpnThresholdSlackDivisor`), or until this
+      // node reaches one of its thresholds.
+      const uint32_t child_phi_threshold =
+          static_cast<uint32_t>(std::min<uint64_t>(
+              delta_threshold - phi_sum + best_child->numbers.phi,
+              kInfiniteProofNumber));
+      const uint64_t slack =
+          std::max<uint64_t>(second_min_delta / kDfpnThresholdSlackDivisor, 1);
+      const uint32_t child_delta_threshold = static_cast<uint32_t>(
+          std::min<uint64_t>(second_min_delta + slack, phi_threshold));
+      ApplyMove(best_child->move);
+      best_child->numbers =
+          DfpnMID(ply + 1, child_phi_threshold, child_delta_threshold);
+      UndoMove(best_child->move);
+    }
+    // If the root is proved, its best child is the move that proves it.
+    if (ply == 0 && best_child != nullptr) dfpn_root_move_ = best_child->move;
+    const long long work = nodes_left_before - dfpn_nodes_left_ + 1;
+    StoreProofNumbers(
+        plies_left, numbers,
+        static_cast<uint32_t>(
+            std::min<long long>(work, std::numeric_limits<uint32_t>::max())));
+    return numbers;
+  }
+
+  // Whether the attacker may still reach the goal of the search in `sit_`
+  // within `plies_left` plies. A player walks at most two cells per move, so
+  // it needs at least `PliesToGoal` plies to win. A draw needs P0 to reach its
+  // goal.
+  bool AttackerCanSucceed(int plies_left) const {
+    if (PliesToGoal(dfpn_attacker_) <= plies_left) return true;
+    return dfpn_draw_is_success_ && dfpn_attacker_ == 1 &&
+           PliesToGoal(0) <= plies_left;
+  }
+  int PliesToGoal(int player) const {
+    const int dist = sit_.G.Distance(sit_.tokens[player], Goals(R, C)[player]);
+    const int moves = (dist + 1) / 2;
+    return sit_.turn == player ? 2 * moves - 1 : 2 * moves;
+  }
+
+  // Reads the numbers of `sit_` with `plies_left` plies left from the table,
+  // or returns `unknown_numbers` if they are not there.
+  MoverProofNumbers LookupProofNumbers(
+      int plies_left, MoverProofNumbers unknown_numbers = {1, 1}) const {
+    uint32_t proof;
+    uint32_t disproof;
+    if (!proof_numbers_->Lookup(sit_hash_, dfpn_goal_, sit_, plies_left, proof,
+                                disproof))
+      return unknown_numbers;
+    if (sit_.turn == dfpn_attacker_) return {proof, disproof};
+    return {disproof, proof};
+  }
+  void StoreProofNumbers(int plies_left, MoverProofNumbers numbers,
+                         uint32_t work) {
+    if (sit_.turn == dfpn_attacker_) {
+      proof_numbers_->Store(sit_hash_, dfpn_goal_, sit_, plies_left,
+                            numbers.phi, numbers.delta, work);
+    } else {
+      proof_numbers_->Store(sit_hash_, dfpn_goal_, sit_, plies_left,
+                            numbers.delta, numbers.phi, work);
+    }
+  }
+
+  // Evaluates situation `sit_` with the formula dist(p1, g1) - dist(p0, g0),
+  // plus the output of the network, if any (see `SetNnue`). Higher is better
+  // for P0.
+  inline int LeafEval() {
+    const std::array<int, 2> goal_distances = GoalDistances();
+    return goal_distances[1] - goal_distances[0] + NnueEval();
+  }
+
+  // Returns the distances of P0 and P1 to their goals in `sit_`, from the
+  // evaluation cache if possible. See `EvalCache`.
+  std::array<int, 2> GoalDistances() {
+    std::array<int, 2> goal_distances;
+    if (ProbeEvalCache(goal_distances)) return goal_distances;
+    for (int player : {0, 1}) {
+      goal_distances[player] =
+          sit_.G.Distance(sit_.tokens[player], Goals(R, C)[player]);
+    }
+    StoreEvalCache(goal_distances);
+    return goal_distances;
+  }
+
+  // A hit saves the two BFS of `GoalDistances`.
+  bool ProbeEvalCache(std::array<int, 2>& goal_distances) {
+    if (!eval_cache_enabled_) return false;
+    METRIC_INC(eval_cache_probes);
+    if (!eval_cache_.Probe(PositionKey(), goal_distances)) return false;
+    METRIC_INC(eval_cache_hits);
+    METRIC_ADD(eval_cache_saved_primitives, 2);
+    return true;
+  }
+  void StoreEvalCache(const std::array<int, 2>& goal_distances) {
+    if (eval_cache_enabled_) eval_cache_.Store(PositionKey(), goal_distances);
+  }
+
+  // Hash of `sit_` without the turn.
+  inline uint64_t PositionKey() const {
+    return sit_.turn == 0 ? sit_hash_ : sit_hash_ ^ kZobristKeys<R, C>.turn;
+  }
+
+  // Output of the network for `sit_`, or 0 if there is none. Higher is better
+  // for P0.
+  inline int NnueEval() const {
+    return nnue_ == nullptr ? 0 : nnue_->Evaluate(nnue_accumulator_);
+  }
+
+  // Evaluates `sit_`, which is not game over, at depth 0 with window
+  // [`alpha`, `beta`]. See `kQuiescenceNodeBudget`. Higher is better for the
+  // player to move.
+  int QuiescenceEval(int alpha, int beta) {
+    const int turn = sit_.turn;
+    const int opp_turn = 1 - turn;
+    const int token = sit_.tokens[turn];
+    // On a miss in the evaluation cache, the distances to the goal of the
+    // player to move are computed from every node, since extending moves also
+    // needs them.
+    std::array<int, NumNodes(R, C)> distances_from_goal;
+    bool has_distances_from_goal = false;
+    std::array<int, 2> goal_distances;
+    if (!ProbeEvalCache(goal_distances)) {
+      distances_from_goal = sit_.G.Distances(Goals(R, C)[turn]);
+      has_distances_from_goal = true;
+      goal_distances[turn] = distances_from_goal[token];
+      goal_distances[opp_turn] =
+          sit_.G.Distance(sit_.tokens[opp_turn], Goals(R, C)[opp_turn]);
+      StoreEvalCache(goal_distances);
+    }
+    const int dist = goal_distances[turn];
+    const int opp_dist = goal_distances[opp_turn];
+    // Every move has two actions, so at distance 1 the player also needs a
+    // wall to build, which it lacks if every edge is a bridge (see the example
+    // in `UselessEdgeAfterWalk`).
+    if (dist == 2 || (dist == 1 && CanBuildWall())) {
+      // The player can reach the goal with its next move. That wins, as if the
+      // game ended at depth -1, unless it is player 0 and player 1 is also
+      // within distance 2, which is a draw.
+      if (turn == 1 || opp_dist > 2) {
+        METRIC_INC(quiescence_wins);
+        return kGameOverEval - 1;
+      }
+      return std::max(opp_dist - dist, 0);
+    }
+    // Stand pat: the static eval is a lower bound, since there are almost
+    // always moves that do not make the player's situation worse.
+    int best_eval = opp_dist - dist + (turn == 0 ? 1 : -1) * NnueEval();
+    if (best_eval >= beta || quiescence_nodes_left_ <= 0 ||
+        opp_dist > kQuiescenceThreatDistance)
+      return best_eval;
+    alpha = std::max(alpha, best_eval);
+
+    if (!has_distances_from_goal) {
+      distances_from_goal = sit_.G.Distances(Goals(R, C)[turn]);
+      // The cache hit only saved one BFS.
+      METRIC_ADD(eval_cache_saved_primitives, -1);
+    }
+    const std::array<int, NumNodes(R, C)> opp_path_edges =
+        sit_.G.EdgesInEveryShortestPath(sit_.tokens[opp_turn],
+                                        Goals(R, C)[opp_turn]);
+    int next_node = -1;
+    for (int nbr : sit_.G.GetNeighbors(token)) {
+      if (nbr != -1 && distances_from_goal[nbr] == dist - 1) next_node = nbr;
+    }
+    int num_moves = 0;
+    for (int edge : opp_path_edges) {
+      if (edge == -1 || num_moves == kQuiescenceMaxMoves ||
+          quiescence_nodes_left_ <= 0)
+        break;
+      const Move move = WalkAndBuildMove(token, next_node, edge);
+      if (!sit_.IsLegalMove(move)) continue;
+      ++num_moves;
+      --quiescence_nodes_left_;
+      METRIC_INC(quiescence_nodes);
+      ApplyMove(move);
+      const int eval = -QuiescenceEval(-beta, -alpha);
+      UndoMove(move);
+      if (eval > best_eval) {
+        best_eval = eval;
+        if (best_eval >= beta) break;
+        alpha = std::max(alpha, best_eval);
+      }
+    }
+    return best_eval;
+  }
+
+  // For a non-PV node at depth 1 or 2, returns an upper bound of its eval that
+  // is at most `alpha` if futility pruning or razoring shows that it fails
+  // low, or a value larger than `alpha` otherwise. See `kFutilityMargin`.
+  int FutilityEval(int depth, int alpha) {
+    const int turn = sit_.turn;
+    const std::array<int, 2> goal_distances = GoalDistances();
+    const int dist = goal_distances[turn];
+    // The player to move may win immediately, which the static eval ignores.
+    if (dist <= 2) return alpha + 1;
+    const int opp_dist = goal_distances[1 - turn];
+    const int static_eval = opp_dist - dist;
+    if (depth == 1) {
+      if (static_eval + kFutilityMargin > alpha) return alpha + 1;
+      METRIC_INC(futility_prunes[depth]);
+      return static_eval + kFutilityMargin;
+    }
+    if (static_eval + kRazoringMargin > alpha) return alpha + 1;
+    const int eval = NegamaxEval(depth - 1, alpha, alpha + 1);
+    if (eval <= alpha && !IsAborted()) METRIC_INC(futility_prunes[depth]);
+    return eval;
   }
 
   Move GetDoubleWalkMove() {
@@ -253,29 +2079,25 @@ class Negamax {
     return DoubleWalkMove(sit_.tokens[sit_.turn], 996);
   }
 
-  // Returns a list of legal moves ordered heuristically from best to worst
-  // while trying to minimize the number of graph operations (distance
-  // computations, reachability checks, etc.). It might not return every legal
-  // move; it excludes moves that are provably suboptimal. Note: calls with a
-  // given `depth` value overwrites the output returned for previous calls for
-  // the same `depth`.
-  nonstd::span<const ScoredMove> OrderedMoves(int depth) {
-    // The size is an upper bound on the number of possible
-    // moves. There is one thread_local array for each depth of the negamax
-    // search. The function returns a prefix of the array for the given `depth`
-    // as a span, so that no copies or allocations of the arrays need to happen.
-    thread_local std::array<std::array<ScoredMove, MaxNumLegalMoves(R, C)>,
-                            kMaxDepth>
-        move_lists_all_depths;
-    // `moves` is a reference to the array for the given `depth`. We will place
-    // the moves in a prefix of `moves`.
-    std::array<ScoredMove, MaxNumLegalMoves(R, C)>& moves =
-        move_lists_all_depths[depth];
-    // `move_index` is the first unused index in `moves`. It will advance for
-    // each move generated. The function will return a span of `moves` from
-    // index 0 to index `move_index`.
-    int move_index = 0;
-
+  // Information about `sit_` shared by the stages of move generation.
+  struct MoveGenerationContext {
+    std::array<int, 2> tokens;
+    int turn;
+    int opp_turn;
+    std::array<std::array<int, NumNodes(R, C)>, 2> shortest_paths;
+    std::array<std::bitset<NumRealAndFakeEdges(R, C)>, 2> SP_edges;
+    Graph<R, C> G_pruned;
+    int opp_dist;
+    std::array<int, NumRealAndFakeEdges(R, C)> edge_labels;
+    int num_labels;
+    // Distances in `G_pruned` to the goal of the player to move.
+    std::array<int, NumNodes(R, C)> distances_from_goal;
+    // A pruned edge that can still be built, or -1 if there is none. See
+    // `UselessEdgeAfterWalk`.
+    int useless_edge;
+  };
+
+  MoveGenerationContext PrepareMoveGeneration() const {
     // int8_t to int conversions.
     const std::array<int, 2> tokens = {sit_.tokens[0], sit_.tokens[1]};
     const int turn = sit_.turn;
@@ -365,137 +2187,191 @@ class Negamax {
       num_labels = max_label + 1;
     }
 
-    // Generate double-walk moves and walk-and-build moves.
-    {
-      const std::array<int, NumNodes(R, C)> distances_from_goal =
-          G_pruned.Distances(Goals(R, C)[turn]);
-
-      // Generate double-walk moves. They are scored based on how much they
-      // reduce the distance to the goal. Each one-step reduction gets a score
-      // of 10. Thus, moves can have a score of -20, 0, or 20.
-      for (int node : G_pruned.NodesAtDistance2(tokens[turn])) {
-        if (node == -1) continue;
-        if (distances_from_goal[node] == 0) {
-          bool is_draw_by_one_move = turn == 0 && opp_dist <= 2;
-          if (!is_draw_by_one_move) {
-            // We found a winning move, so we can discard any previously
-            // generated moves and return the single winning move.
-            moves[0] = {DoubleWalkMove(tokens[turn], node), kWinningMoveScore};
-            DBGS(sit_.CrashIfMoveIsIllegal(moves[0].move));
-            return nonstd::span<const ScoredMove>(moves.begin(),
-                                                  moves.begin() + 1);
-          }
-        }
-        const int dist_to_goal_reduction =
-            distances_from_goal[tokens[turn]] - distances_from_goal[node];
-        moves[move_index++] = {DoubleWalkMove(tokens[turn], node),
-                               10 * dist_to_goal_reduction};
-      }
-
-      // Sometimes, it is convenient to be able to build a useless (but legal)
-      // wall to make it possible to walk only one cell (e.g., if we are at
-      // distance 1 from the goal). We can use one of the pruned edges. For
-      // example, in this situation, edge 0 would be pruned, but it is the only
-      // wall that can be built, so p0 would want to be able to build it and
-      // walk a single square.
-      //      |  |
-      // --+--+--+--
-      //   |  |  |
-      // --+--+--+--
-      //   |  |  |
-      // --+--+--+--
-      // g1    p0 p1 (g0 is at the same cell as p1).
-      int useless_edge = -1;
-      for (int edge = 0; edge < NumRealAndFakeEdges(R, C); ++edge) {
-        if (sit_.G.edges[edge] && !G_pruned.edges[edge]) {
-          useless_edge = edge;
-          break;
-        }
+    const std::array<int, NumNodes(R, C)> distances_from_goal =
+        G_pruned.Distances(Goals(R, C)[turn]);
+
+    int useless_edge = -1;
+    for (int edge = 0; edge < NumRealAndFakeEdges(R, C); ++edge) {
+      if (sit_.G.edges[edge] && !G_pruned.edges[edge]) {
+        useless_edge = edge;
+        break;
       }
+    }
 
-      // Generate walk-and-build moves.
-      for (int node : G_pruned.GetNeighbors(tokens[turn])) {
-        if (node == -1) continue;
-        const int dist_to_goal_reduction =
-            distances_from_goal[tokens[turn]] - distances_from_goal[node];
-        const int walk_score = distances_from_goal[node] == 0
-                                   ? kWinningMoveScore
-                                   : 10 * dist_to_goal_reduction;
-
-        // If we did not prune any edge in `G_pruned`, we would not have found a
-        // useless edge yet. However, the edge crossed by the player to move to
-        // `node` may become useless.
-        int useless_edge_after_move = -1;
-        if (useless_edge != -1) {
-          useless_edge_after_move = useless_edge;
-        } else {
-          int candidate_useless_edge =
-              EdgeBetweenNeighbors(R, C, tokens[turn], node);
-          // `candidate_useless_edge` can be a useless edge if the move to
-          // `node` turns it into a bridge to a "useless zone". The necessary
-          // and sufficient conditions are: (i) `candidate_useless_edge` is a
-          // bridge; (ii) `candidate_useless_edge` is not part of the shortest
-          // path of the other player.
-          if (edge_labels[candidate_useless_edge] == -1 &&
-              !SP_edges[opp_turn][candidate_useless_edge]) {
-            useless_edge_after_move = candidate_useless_edge;
-          }
-        }
-        // At this point, we may or may not have a useless edge. For example, in
-        // the following situation there are no useless edges:
-        //   |  |  |
-        // --+--+--+--
-        //   |  |  |
-        // --+--+--+--
-        //   |  |  |
-        // --+--+--+--
-        // g1    p0 p1 (g0 is at the same cell as p1).
-        // If it is p0's turn, p0 cannot win even though it is next to the goal,
-        // because it cannot build any wall. They are all bridges in the path
-        // from a player to its goal.
-
-        // Consider edges to build along with the move to `node`.
-        for (int edge = 0; edge < NumRealAndFakeEdges(R, C); edge++) {
-          // Ignore disabled edges, except the useless edge.
-          if (edge_labels[edge] == -2 && edge != useless_edge_after_move)
-            continue;
+    return {tokens,     turn,
+            opp_turn,   shortest_paths,
+            SP_edges,   G_pruned,
+            opp_dist,   edge_labels,
+            num_labels, distances_from_goal,
+            useless_edge};
+  }
 
-          // Ignore bridges (since they can't be built, unless they became
-          // useless due to the move)
-          if (edge_labels[edge] == -1 && edge != useless_edge_after_move)
-            continue;
+  // Generates double-walk moves and walk-and-build moves at the end of the
+  // first `move_index` moves of `moves`, and advances `move_index`. If there is
+  // a winning move, it is the only one generated, and the function returns
+  // true.
+  bool GenerateWalkMoves(const MoveGenerationContext& ctx, MoveList& moves,
+                         int& move_index) const {
+    if (GenerateDoubleWalkMoves(ctx, moves, move_index)) return true;
+    GenerateWalkAndBuildMoves(ctx, moves, move_index);
+    return false;
+  }
 
-          if (walk_score == kWinningMoveScore) {
-            bool is_draw_by_one_move = turn == 0 && opp_dist <= 2;
-            if (!is_draw_by_one_move) {
-              // We found a winning move, so we can discard any previously
-              // generated moves and return the single winning move.
-              moves[0] = {WalkAndBuildMove(tokens[turn], node, edge),
-                          kWinningMoveScore};
-              DBGS(sit_.CrashIfMoveIsIllegal(moves[0].move));
-              return nonstd::span<const ScoredMove>(moves.begin(),
-                                                    moves.begin() + 1);
-            }
-          }
-          // We score walk-and-build moves as follows: if the wall is in the
-          // shortest path of the opponent, it gets a bonus of +5. If it is in
-          // the player's shortest path, it gets a penalty of -4. The bonuses
-          // and penalties are added to the walk score. Thus, moves can have a
-          // score of -14, -10, -9, -5, 6, 10, 11, or 15. (We could compute how
-          // much the distance to the goal of each player actually changes due
-          // to building the wall, but that would require 2 extra graph
-          // traversals.)
-          const int wall_score = (SP_edges[turn][edge] ? -4 : 0) +
-                                 (SP_edges[opp_turn][edge] ? 5 : 0);
-          moves[move_index++] = {WalkAndBuildMove(tokens[turn], node, edge),
-                                 walk_score + wall_score};
-        }
+  // Like `GenerateWalkMoves`, for double-walk moves only, but a winning
+  // walk-and-build move also counts as a winning move.
+  bool GenerateDoubleWalkMoves(const MoveGenerationContext& ctx,
+                               MoveList& moves, int& move_index) const {
+    const std::array<int, 2>& tokens = ctx.tokens;
+    const int turn = ctx.turn;
+    const Graph<R, C>& G_pruned = ctx.G_pruned;
+    const auto& distances_from_goal = ctx.distances_from_goal;
+    const int first_index = move_index;
+    const bool is_draw_by_one_move = turn == 0 && ctx.opp_dist <= 2;
+
+    // Generate double-walk moves. They are scored based on how much they
+    // reduce the distance to the goal. Each one-step reduction gets a score
+    // of 10. Thus, moves can have a score of -20, 0, or 20.
+    for (int node : G_pruned.NodesAtDistance2(tokens[turn])) {
+      if (node == -1) continue;
+      if (distances_from_goal[node] == 0 && !is_draw_by_one_move) {
+        // We found a winning move, so we can discard any previously
+        // generated walks and return the single winning move.
+        moves[first_index] = {DoubleWalkMove(tokens[turn], node),
+                              kWinningMoveScore};
+        DBGS(sit_.CrashIfMoveIsIllegal(moves[first_index].move));
+        move_index = first_index + 1;
+        return true;
+      }
+      const int dist_to_goal_reduction =
+          distances_from_goal[tokens[turn]] - distances_from_goal[node];
+      moves[move_index++] = {DoubleWalkMove(tokens[turn], node),
+                             10 * dist_to_goal_reduction};
+    }
+
+    // A walk to the goal wins with any wall that can be built along with it,
+    // if there is one (see `UselessEdgeAfterWalk`).
+    if (is_draw_by_one_move) return false;
+    for (int node : G_pruned.GetNeighbors(tokens[turn])) {
+      if (node == -1 || distances_from_goal[node] != 0) continue;
+      const int useless_edge_after_move = UselessEdgeAfterWalk(ctx, node);
+      for (int edge = 0; edge < NumRealAndFakeEdges(R, C); edge++) {
+        if (!CanBuildWithWalk(ctx, edge, useless_edge_after_move)) continue;
+        moves[first_index] = {WalkAndBuildMove(tokens[turn], node, edge),
+                              kWinningMoveScore};
+        DBGS(sit_.CrashIfMoveIsIllegal(moves[first_index].move));
+        move_index = first_index + 1;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // Like `GenerateWalkMoves`, for walk-and-build moves only. Assumes that
+  // `GenerateDoubleWalkMoves` found no winning move, so none of them wins.
+  void GenerateWalkAndBuildMoves(const MoveGenerationContext& ctx,
+                                 MoveList& moves, int& move_index) const {
+    const std::array<int, 2>& tokens = ctx.tokens;
+    const int turn = ctx.turn;
+    const int opp_turn = ctx.opp_turn;
+    const auto& SP_edges = ctx.SP_edges;
+    const auto& distances_from_goal = ctx.distances_from_goal;
+
+    for (int node : ctx.G_pruned.GetNeighbors(tokens[turn])) {
+      if (node == -1) continue;
+      const int dist_to_goal_reduction =
+          distances_from_goal[tokens[turn]] - distances_from_goal[node];
+      // A walk to the goal that does not win is a draw by one move.
+      const int walk_score = distances_from_goal[node] == 0
+                                 ? kWinningMoveScore
+                                 : 10 * dist_to_goal_reduction;
+      const int useless_edge_after_move = UselessEdgeAfterWalk(ctx, node);
+
+      // Consider edges to build along with the move to `node`.
+      for (int edge = 0; edge < NumRealAndFakeEdges(R, C); edge++) {
+        if (!CanBuildWithWalk(ctx, edge, useless_edge_after_move)) continue;
+        // We score walk-and-build moves as follows: if the wall is in the
+        // shortest path of the opponent, it gets a bonus of +5. If it is in
+        // the player's shortest path, it gets a penalty of -4. The bonuses
+        // and penalties are added to the walk score. Thus, moves can have a
+        // score of -14, -10, -9, -5, 6, 10, 11, or 15. (We could compute how
+        // much the distance to the goal of each player actually changes due
+        // to building the wall, but that would require 2 extra graph
+        // traversals.)
+        const int wall_score = (SP_edges[turn][edge] ? -4 : 0) +
+                               (SP_edges[opp_turn][edge] ? 5 : 0);
+        moves[move_index++] = {WalkAndBuildMove(tokens[turn], node, edge),
+                               walk_score + wall_score};
       }
     }
 
     // Note: we could consider generating double-build moves with the useless
     // edge and a real edge. However, it's hard to imagine a situation where
     // that would be optimal.
+  }
+
+  // Sometimes, it is convenient to be able to build a useless (but legal)
+  // wall to make it possible to walk only one cell (e.g., if we are at
+  // distance 1 from the goal). We can use one of the pruned edges. For
+  // example, in this situation, edge 0 would be pruned, but it is the only
+  // wall that can be built, so p0 would want to be able to build it and
+  // walk a single square.
+  //      |  |
+  // --+--+--+--
+  //   |  |  |
+  // --+--+--+--
+  //   |  |  |
+  // --+--+--+--
+  // g1    p0 p1 (g0 is at the same cell as p1).
+  // Returns such an edge for a walk to `node`, or -1 if there is none.
+  int UselessEdgeAfterWalk(const MoveGenerationContext& ctx, int node) const {
+    // If we did not prune any edge in `G_pruned`, we would not have found a
+    // useless edge yet. However, the edge crossed by the player to move to
+    // `node` may become useless.
+    if (ctx.useless_edge != -1) return ctx.useless_edge;
+    const int candidate_useless_edge =
+        EdgeBetweenNeighbors(R, C, ctx.tokens[ctx.turn], node);
+    // `candidate_useless_edge` can be a useless edge if the move to `node`
+    // turns it into a bridge to a "useless zone". The necessary and
+    // sufficient conditions are: (i) `candidate_useless_edge` is a bridge;
+    // (ii) `candidate_useless_edge` is not part of the shortest path of the
+    // other player.
+    if (ctx.edge_labels[candidate_useless_edge] == -1 &&
+        !ctx.SP_edges[ctx.opp_turn][candidate_useless_edge]) {
+      return candidate_useless_edge;
+    }
+    // There may be no useless edge. For example, in the following situation
+    // there are none:
+    //   |  |  |
+    // --+--+--+--
+    //   |  |  |
+    // --+--+--+--
+    //   |  |  |
+    // --+--+--+--
+    // g1    p0 p1 (g0 is at the same cell as p1).
+    // If it is p0's turn, p0 cannot win even though it is next to the goal,
+    // because it cannot build any wall. They are all bridges in the path
+    // from a player to its goal.
+    return -1;
+  }
+
+  // Whether `edge` is a wall to build along with a walk, given the useless
+  // edge after the walk (see `UselessEdgeAfterWalk`). Disabled edges and
+  // bridges are skipped, since they can't be built, unless they became useless
+  // due to the walk.
+  static bool CanBuildWithWalk(const MoveGenerationContext& ctx, int edge,
+                               int useless_edge_after_move) {
+    return ctx.edge_labels[edge] >= 0 || edge == useless_edge_after_move;
+  }
+
+  // Like `GenerateWalkMoves`, for double-build moves with walls in different
+  // two-edge-connected components.
+  void GenerateCrossComponentDoubleBuilds(const MoveGenerationContext& ctx,
+                                          MoveList& moves,
+                                          int& move_index) const {
+    const int turn = ctx.turn;
+    const int opp_turn = ctx.opp_turn;
+    const auto& SP_edges = ctx.SP_edges;
+    const auto& edge_labels = ctx.edge_labels;
 
     // Generate double-build moves consisting of edges in different
     // two-edge-connected components. These moves are cheap to generate since
@@ -519,6 +2395,18 @@ class Negamax {
                                edge1_score + edge2_score};
       }
     }
+  }
+
+  // Like `GenerateWalkMoves`, for double-build moves with walls in the same
+  // two-edge-connected component.
+  void GenerateIntraComponentDoubleBuilds(const MoveGenerationContext& ctx,
+                                          MoveList& moves,
+                                          int& move_index) const {
+    const int turn = ctx.turn;
+    const int opp_turn = ctx.opp_turn;
+    const auto& shortest_paths = ctx.shortest_paths;
+    const auto& edge_labels = ctx.edge_labels;
+    const int num_labels = ctx.num_labels;
 
     // Generate double-build moves consisting of edges in the same
     // two-edge-connected components. These are the hardest ones to generate
@@ -641,13 +2529,57 @@ class Negamax {
         }
       }
     }
+  }
+
+  // Returns a list of legal moves ordered heuristically from best to worst
+  // while trying to minimize the number of graph operations (distance
+  // computations, reachability checks, etc.). It might not return every legal
+  // move; it excludes moves that are provably suboptimal. Note: calls with a
+  // given `depth` value overwrites the output returned for previous calls for
+  // the same `depth`. If `ply` is not -1, the order also uses the killer,
+  // history, and countermove heuristics for that ply of the current search.
+  // The search itself uses `StagedMoves`, which produces the moves lazily.
+  nonstd::span<const ScoredMove> OrderedMoves(int depth, int ply = -1) {
+    // The function returns a prefix of the array in `move_lists_` for the
+    // given `depth` as a span, so that no copies or allocations of the arrays
+    // need to happen.
+    // `moves` is a reference to the array for the given `depth`. We will place
+    // the moves in a prefix of `moves`.
+    MoveList& moves = (*move_lists_)[depth];
+    // `move_index` is the first unused index in `moves`. It will advance for
+    // each move generated. The function will return a span of `moves` from
+    // index 0 to index `move_index`.
+    int move_index = 0;
+
+    const MoveGenerationContext ctx = PrepareMoveGeneration();
+    if (GenerateWalkMoves(ctx, moves, move_index)) {
+      return nonstd::span<const ScoredMove>(moves.begin(), moves.begin() + 1);
+    }
+    GenerateCrossComponentDoubleBuilds(ctx, moves, move_index);
+    GenerateIntraComponentDoubleBuilds(ctx, moves, move_index);
+
+    if (ply != -1) {
+      AddHeuristicScores(
+          nonstd::span<ScoredMove>(moves.begin(), moves.begin() + move_index),
+          ply);
+    }
 
     // Sort the moves from largest to smallest score.
     // Todo: maybe bucket sort is faster?
-    std::sort(moves.begin(), moves.begin() + move_index,
-              [](const ScoredMove& lhs, const ScoredMove& rhs) {
-                return lhs.score > rhs.score;
-              });
+    if (move_order_seed_ == 0) {
+      std::sort(moves.begin(), moves.begin() + move_index,
+                [](const ScoredMove& lhs, const ScoredMove& rhs) {
+                  return lhs.score > rhs.score;
+                });
+    } else {
+      // Lazy SMP helpers add a small, move-dependent amount to the scores so
+      // that they explore moves with equal or similar scores in a different
+      // order than the main searcher.
+      std::sort(moves.begin(), moves.begin() + move_index,
+                [this](const ScoredMove& lhs, const ScoredMove& rhs) {
+                  return PerturbedScore(lhs) > PerturbedScore(rhs);
+                });
+    }
 
     // Only in debug mode, assert that every move generated is legal.
     DBGS(for (auto scored_move
@@ -660,6 +2592,209 @@ class Negamax {
                                           moves.begin() + move_index);
   }
 
+  // Produces the moves of `OrderedMoves` lazily, in stages, for the search.
+  // The hash move and a double walk are searched before (see `NegamaxEval`),
+  // and the stages skip them. The stages are:
+  // 1. Double walks. If there is a winning move, it is the only move. See
+  //    `GenerateDoubleWalkMoves`.
+  // 2. Walk-and-build moves.
+  // 3. Double-build moves with walls in different two-edge-connected
+  //    components.
+  // 4. Double-build moves with walls in the same component, the only stage
+  //    that runs graph searches besides the ones of `PrepareMoveGeneration`.
+  // 5. Deferred moves: the ones of stage 4 that may be illegal.
+  // A stage is generated when the first of its moves is requested, so a node
+  // that cuts off only pays for the stages that it reaches. Within a stage,
+  // the first `kNumSelectedMovesPerStage` moves are found by linear scans, and
+  // the rest are sorted only if the search gets that far.
+  class StagedMoves {
+   public:
+    // `searched_moves` are moves already searched at the node (e.g., the
+    // cached move), which are skipped.
+    StagedMoves(Negamax& negamax, int depth, int ply,
+                std::array<Move, 2> searched_moves)
+        : negamax_(negamax),
+          moves_((*negamax.move_lists_)[depth]),
+          ply_(ply),
+          searched_moves_(searched_moves),
+          deferred_begin_(static_cast<int>(moves_.size())) {}
+
+    // Returns the `i`-th move in order, or nullptr if there are not more than
+    // `i` moves. Moves must be requested in increasing order of `i`.
+    const ScoredMove* Get(int i) {
+      while (i >= ordered_end_) {
+        if (ordered_end_ == stage_end_) {
+          if (!GenerateNextStage()) return nullptr;
+        } else if (num_selected_in_stage_ < kNumSelectedMovesPerStage) {
+          SelectBest();
+        } else {
+          SortRestOfStage();
+        }
+      }
+      return &moves_[i];
+    }
+
+    // Like `Get`, but returns nullptr instead of generating any stage other
+    // than the first one or sorting. Moves can be peeked at in any order.
+    const ScoredMove* Peek(int i) {
+      if (ordered_end_ == 0 && ordered_end_ == stage_end_ &&
+          !GenerateNextStage())
+        return nullptr;
+      while (i >= ordered_end_ && ordered_end_ < stage_end_ &&
+             num_selected_in_stage_ < kNumSelectedMovesPerStage) {
+        SelectBest();
+      }
+      return i < ordered_end_ ? &moves_[i] : nullptr;
+    }
+
+    // Generates and orders every remaining move, and returns the moves from
+    // the `i`-th one on.
+    nonstd::span<const ScoredMove> GetAllFrom(int i) {
+      while (Get(ordered_end_) != nullptr) SortRestOfStage();
+      return nonstd::span<const ScoredMove>(moves_.begin() + i,
+                                            moves_.begin() + ordered_end_);
+    }
+
+    // Number of moves generated so far.
+    int NumGenerated() const {
+      return stage_end_ + static_cast<int>(moves_.size()) - deferred_begin_;
+    }
+
+   private:
+    static constexpr int kNumSelectedMovesPerStage = 3;
+
+    enum Stage {
+      kDoubleWalkStage,
+      kWalkAndBuildStage,
+      kCrossComponentStage,
+      kIntraComponentStage,
+      kDeferredStage,
+      kNoStage
+    };
+
+    // Generates the moves of the next non-empty stage at `stage_end_`.
+    // Returns false if there are no more moves.
+    bool GenerateNextStage() {
+      while (stage_ != kNoStage) {
+        const int stage_begin = stage_end_;
+        int move_index = stage_end_;
+        const Stage stage = stage_;
+        stage_ = static_cast<Stage>(stage_ + 1);
+        if (stage == kDeferredStage) {
+          move_index = static_cast<int>(
+              std::copy(moves_.begin() + deferred_begin_, moves_.end(),
+                        moves_.begin() + stage_end_) -
+              moves_.begin());
+          deferred_begin_ = static_cast<int>(moves_.size());
+        } else {
+          if (stage == kDoubleWalkStage) {
+            ctx_ = negamax_.PrepareMoveGeneration();
+            if (negamax_.GenerateDoubleWalkMoves(ctx_, moves_, move_index))
+              stage_ = kNoStage;
+          } else if (stage == kWalkAndBuildStage) {
+            negamax_.GenerateWalkAndBuildMoves(ctx_, moves_, move_index);
+          } else if (stage == kCrossComponentStage) {
+            negamax_.GenerateCrossComponentDoubleBuilds(ctx_, moves_,
+                                                        move_index);
+          } else /*(stage == kIntraComponentStage)*/ {
+            negamax_.GenerateIntraComponentDoubleBuilds(ctx_, moves_,
+                                                        move_index);
+          }
+          if (ply_ != -1) {
+            negamax_.AddHeuristicScores(
+                nonstd::span<ScoredMove>(moves_.begin() + stage_begin,
+                                         moves_.begin() + move_index),
+                ply_);
+          }
+          move_index =
+              RemoveSearchedAndDeferredMoves(stage_begin, move_index);
+        }
+        stage_end_ = move_index;
+        num_selected_in_stage_ = 0;
+        if (stage_end_ > stage_begin) return true;
+      }
+      return false;
+    }
+
+    // Removes the moves already searched from the moves in [`begin`, `end`),
+    // and moves the ones that are deferred to the end of `moves_`. Returns the
+    // new end.
+    int RemoveSearchedAndDeferredMoves(int begin, int end) {
+      const auto first = moves_.begin() + begin;
+      const auto last = std::remove_if(
+          first, moves_.begin() + end, [this](const ScoredMove& scored_move) {
+            return scored_move.move == searched_moves_[0] ||
+                   scored_move.move == searched_moves_[1];
+          });
+      const auto deferred =
+          std::partition(first, last, [](const ScoredMove& scored_move) {
+            return scored_move.score != kPossiblyIllegalMoveScore;
+          });
+      const int new_end = static_cast<int>(deferred - moves_.begin());
+      // Every generated move fits in `moves_`, so `deferred_begin_ >= end`,
+      // and copying from the back does not overwrite moves not copied yet.
+      for (int i = static_cast<int>(last - moves_.begin()); i-- > new_end;) {
+        moves_[--deferred_begin_] = moves_[i];
+      }
+      return new_end;
+    }
+
+    int OrderingScore(const ScoredMove& scored_move) const {
+      return negamax_.move_order_seed_ == 0
+                 ? scored_move.score
+                 : negamax_.PerturbedScore(scored_move);
+    }
+
+    // Moves the best remaining move of the stage to `ordered_end_`.
+    void SelectBest() {
+      int best = ordered_end_;
+      for (int i = ordered_end_ + 1; i < stage_end_; ++i) {
+        if (OrderingScore(moves_[i]) > OrderingScore(moves_[best])) best = i;
+      }
+      std::swap(moves_[ordered_end_], moves_[best]);
+      ++ordered_end_;
+      ++num_selected_in_stage_;
+    }
+
+    void SortRestOfStage() {
+      std::sort(moves_.begin() + ordered_end_, moves_.begin() + stage_end_,
+                [this](const ScoredMove& lhs, const ScoredMove& rhs) {
+                  return OrderingScore(lhs) > OrderingScore(rhs);
+                });
+      ordered_end_ = stage_end_;
+    }
+
+    Negamax& negamax_;
+    MoveList& moves_;
+    const int ply_;
+    const std::array<Move, 2> searched_moves_;
+    Stage stage_ = kDoubleWalkStage;
+    // Set when the first stage is generated.
+    MoveGenerationContext ctx_;
+    // `moves_` is laid out as follows:
+    // - [0, `ordered_end_`): moves returned or ready to be returned, in order.
+    // - [`ordered_end_`, `stage_end_`): the other moves of the current stage.
+    // - [`deferred_begin_`, end): the moves of the deferred stage, unless it
+    //   is the current stage.
+    int ordered_end_ = 0;
+    int stage_end_ = 0;
+    int deferred_begin_;
+    int num_selected_in_stage_ = 0;
+  };
+
+  // Returns the score of `scored_move` plus a pseudorandom value between 0 and
+  // 3 that depends on the move and `move_order_seed_`.
+  inline int PerturbedScore(const ScoredMove& scored_move) const {
+    if (scored_move.score == kPossiblyIllegalMoveScore)
+      return kPossiblyIllegalMoveScore;
+    const Move& move = scored_move.move;
+    uint64_t state = move_order_seed_ ^
+                     (static_cast<uint64_t>(move.token_change + 128) << 32) ^
+                     (static_cast<uint64_t>(move.edges[0] + 1) << 16) ^
+                     static_cast<uint64_t>(move.edges[1] + 1);
+    return scored_move.score + static_cast<int>(SplitMix64(state) & 3);
+  }
+
   // Given a list of nodes `node_list` and a set of nodes `node_set`, returns
   // two nodes: (1) the first and last nodes in `node_list` that are in
   // `node_set`, if any, or {-1, -1} otherwise. Assumes that all nodes in
@@ -672,7 +2807,7 @@ class Negamax {
   // 2.d) `node_set` contains s and t. Returns {s, t}.
   // Where x and y are nodes in `node_list` (possibly the same, and possibly
   // equal to s or t).
-  std::array<int, 2> FirstAndLastNodeInSet(
+  static std::array<int, 2> FirstAndLastNodeInSet(
       const std::array<bool, NumNodes(R, C)>& node_set,
       const std::array<int, NumNodes(R, C)>& node_list) {
     int x = -1, y = -1;
@@ -687,12 +2822,17 @@ class Negamax {
     return {x, y};
   }
 
-  Move MoveInTTEntry(const TTEntry<R, C>& entry) {
-    return {entry.token_change, {entry.edge0, entry.edge1}};
+  // Returns the best move in `entry`, which is for `sit_` or its mirror
+  // image, translated to `sit_`.
+  Move MoveInTTEntry(const TTEntry<R, C>& entry, const TTKey& tt_key) {
+    Move move = {entry.token_change, {entry.edge0, entry.edge1}};
+    if (entry.mirrored != tt_key.mirrored) return entry.sit.MirrorMove(move);
+    return move;
   }
 
   friend class Benchmark;
   friend class Tests;
+  friend class Mcts<R, C>;
 };
 
 }  // namespace wallwars
@@ -0,0 +1,263 @@
+#ifndef NNUE_H_
+#define NNUE_H_
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <utility>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "graph.h"
+#include "move.h"
+#include "situation.h"
+#include "transposition_table.h"
+
+namespace wallwars {
+
+// A small quantized network in the style of NNUE ("efficiently updatable
+// neural network") that refines the leaf evaluation of `Negamax` with the wall
+// structure. Its inputs are binary features of a situation: one per built wall,
+// one per player and node for the tokens, and one for the turn. The first layer
+// maps them to `kNnueHiddenSize` int16 values, the accumulator, which is the
+// sum of the weights of the active features, so a move only adds and subtracts
+// the weights of the few features that it changes instead of recomputing it.
+// The output layer applies a clipped ReLU to the accumulator and a dot product
+// with int16 weights. With AVX2, the output layer takes a few instructions.
+constexpr int kNnueHiddenSize = 32;
+// The clipped ReLU maps the accumulator to [0, `kNnueActivationMax`].
+constexpr int kNnueActivationMax = 127;
+// The output is in units of 1 / `kNnueOutputScale` steps of distance.
+constexpr int kNnueOutputScale = 1024;
+
+template <int R, int C>
+constexpr int NumNnueFeatures() {
+  return NumRealAndFakeEdges(R, C) + 2 * NumNodes(R, C) + 1;
+}
+// Feature indices. Fake edges have a feature that is never active.
+constexpr int NnueWallFeature(int edge) { return edge; }
+template <int R, int C>
+constexpr int NnueTokenFeature(int player, int node) {
+  return NumRealAndFakeEdges(R, C) + player * NumNodes(R, C) + node;
+}
+// Active when P1 is to move.
+template <int R, int C>
+constexpr int NnueTurnFeature() {
+  return NumNnueFeatures<R, C>() - 1;
+}
+
+struct NnueAccumulator {
+  alignas(32) std::array<int16_t, kNnueHiddenSize> values;
+
+  bool operator==(const NnueAccumulator& rhs) const {
+    return values == rhs.values;
+  }
+};
+
+// Header of a weights file. The weights are stored raw right after it, in the
+// order of the members of `NnueWeights`.
+struct NnueFileHeader {
+  char magic[8];
+  int32_t R;
+  int32_t C;
+  int32_t num_features;
+  int32_t hidden_size;
+};
+constexpr char kNnueFileMagic[8] = {'W', 'W', 'N', 'N', 'U', 'E', '0', '1'};
+
+template <int R, int C>
+struct NnueWeights {
+  alignas(32) std::array<std::array<int16_t, kNnueHiddenSize>,
+                         NumNnueFeatures<R, C>()> feature_weights;
+  alignas(32) std::array<int16_t, kNnueHiddenSize> hidden_biases;
+  alignas(32) std::array<int16_t, kNnueHiddenSize> output_weights;
+  int32_t output_bias;
+
+  // Weights drawn uniformly from small ranges, e.g., for benchmarks and tests.
+  static std::unique_ptr<NnueWeights> Random(uint64_t seed) {
+    auto weights = std::make_unique<NnueWeights>();
+    auto random_in = [&seed](int range) {
+      return static_cast<int16_t>(
+          static_cast<int>(SplitMix64(seed) % (2 * range + 1)) - range);
+    };
+    for (auto& feature : weights->feature_weights) {
+      for (int16_t& weight : feature) weight = random_in(16);
+    }
+    for (int16_t& bias : weights->hidden_biases) bias = random_in(64);
+    for (int16_t& weight : weights->output_weights) weight = random_in(64);
+    weights->output_bias = random_in(1024);
+    return weights;
+  }
+
+  // Reads the weights from `file_name`, created by `Save()` or by a training
+  // script with the same layout, for the same board size. Returns whether it
+  // succeeded. On failure, the weights are unchanged.
+  bool Load(const std::string& file_name) {
+    std::ifstream fin(file_name, std::ios::binary);
+    if (!fin.is_open()) {
+      std::cerr << "Could not open " << file_name << std::endl;
+      return false;
+    }
+    NnueFileHeader header;
+    fin.read(reinterpret_cast<char*>(&header), sizeof(header));
+    const NnueFileHeader expected = ExpectedHeader();
+    if (!fin || std::memcmp(header.magic, expected.magic, 8) != 0 ||
+        header.R != R || header.C != C ||
+        header.num_features != expected.num_features ||
+        header.hidden_size != expected.hidden_size) {
+      std::cerr << "NNUE weights " << file_name
+                << " are not for this board size" << std::endl;
+      return false;
+    }
+    auto loaded = std::make_unique<NnueWeights>();
+    fin.read(reinterpret_cast<char*>(loaded->feature_weights.data()),
+             sizeof(feature_weights));
+    fin.read(reinterpret_cast<char*>(loaded->hidden_biases.data()),
+             sizeof(hidden_biases));
+    fin.read(reinterpret_cast<char*>(loaded->output_weights.data()),
+             sizeof(output_weights));
+    fin.read(reinterpret_cast<char*>(&loaded->output_bias),
+             sizeof(output_bias));
+    if (!fin) {
+      std::cerr << "NNUE weights " << file_name << " are truncated"
+                << std::endl;
+      return false;
+    }
+    *this = *loaded;
+    return true;
+  }
+
+  // Writes the weights to `file_name`. Returns whether it succeeded.
+  bool Save(const std::string& file_name) const {
+    std::ofstream fout(file_name, std::ios::binary);
+    if (!fout.is_open()) {
+      std::cerr << "Could not open " << file_name << std::endl;
+      return false;
+    }
+    const NnueFileHeader header = ExpectedHeader();
+    fout.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    fout.write(reinterpret_cast<const char*>(feature_weights.data()),
+               sizeof(feature_weights));
+    fout.write(reinterpret_cast<const char*>(hidden_biases.data()),
+               sizeof(hidden_biases));
+    fout.write(reinterpret_cast<const char*>(output_weights.data()),
+               sizeof(output_weights));
+    fout.write(reinterpret_cast<const char*>(&output_bias),
+               sizeof(output_bias));
+    return fout.good();
+  }
+
+  // Computes the accumulator of `sit` from scratch.
+  void Refresh(const Situation<R, C>& sit, NnueAccumulator& acc) const {
+    acc.values = hidden_biases;
+    for (int edge = 0; edge < NumRealAndFakeEdges(R, C); ++edge) {
+      if (IsRealEdge(R, C, edge) && !sit.G.edges[edge])
+        AddFeature(NnueWallFeature(edge), acc);
+    }
+    for (int player : {0, 1})
+      AddFeature(NnueTokenFeature<R, C>(player, sit.tokens[player]), acc);
+    if (sit.turn == 1) AddFeature(NnueTurnFeature<R, C>(), acc);
+  }
+
+  // Updates `acc`, the accumulator of `sit`, to the situation after `move`,
+  // or the reverse if `undo` is true. In both cases, `sit` is the situation
+  // before `move`.
+  void UpdateForMove(const Situation<R, C>& sit, Move move,
+                     NnueAccumulator& acc, bool undo) const {
+    const int from = sit.tokens[sit.turn];
+    std::array<int, 4> added = {-1, -1, -1, -1};
+    std::array<int, 4> removed = {-1, -1, -1, -1};
+    if (move.token_change != 0) {
+      added[0] = NnueTokenFeature<R, C>(sit.turn, from + move.token_change);
+      removed[0] = NnueTokenFeature<R, C>(sit.turn, from);
+    }
+    for (int i = 0; i < 2; ++i) {
+      if (move.edges[i] != -1) added[1 + i] = NnueWallFeature(move.edges[i]);
+    }
+    (sit.turn == 0 ? added : removed)[3] = NnueTurnFeature<R, C>();
+    if (undo) std::swap(added, removed);
+    for (int feature : removed) {
+      if (feature != -1) SubtractFeature(feature, acc);
+    }
+    for (int feature : added) {
+      if (feature != -1) AddFeature(feature, acc);
+    }
+  }
+
+  // Returns the output of the network for the situation of `acc`, in steps of
+  // distance, from the point of view of P0.
+  int Evaluate(const NnueAccumulator& acc) const {
+#ifdef __AVX2__
+    return EvaluateAvx2(acc);
+#else
+    return EvaluateScalar(acc);
+#endif
+  }
+
+  int EvaluateScalar(const NnueAccumulator& acc) const {
+    int32_t sum = output_bias;
+    for (int i = 0; i < kNnueHiddenSize; ++i) {
+      const int32_t activation =
+          std::min(std::max<int32_t>(acc.values[i], 0), kNnueActivationMax);
+      sum += activation * output_weights[i];
+    }
+    return sum / kNnueOutputScale;
+  }
+
+#ifdef __AVX2__
+  int EvaluateAvx2(const NnueAccumulator& acc) const {
+    static_assert(kNnueHiddenSize % 16 == 0,
+                  "The AVX2 path takes 16 int16 values at a time");
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i activation_max = _mm256_set1_epi16(kNnueActivationMax);
+    __m256i sums = zero;
+    for (int i = 0; i < kNnueHiddenSize; i += 16) {
+      __m256i activations = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(&acc.values[i]));
+      activations = _mm256_min_epi16(_mm256_max_epi16(activations, zero),
+                                     activation_max);
+      const __m256i weights = _mm256_loadu_si256(
+          reinterpret_cast<const __m256i*>(&output_weights[i]));
+      // Multiplies the int16 pairs and adds adjacent products into 8 int32.
+      sums = _mm256_add_epi32(sums, _mm256_madd_epi16(activations, weights));
+    }
+    __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sums),
+                                   _mm256_extracti128_si256(sums, 1));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0x4E));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, 0xB1));
+    return (output_bias + _mm_cvtsi128_si32(sum128)) / kNnueOutputScale;
+  }
+#endif
+
+ private:
+  // Plain loops over int16 arrays, which compilers vectorize.
+  inline void AddFeature(int feature, NnueAccumulator& acc) const {
+    for (int i = 0; i < kNnueHiddenSize; ++i)
+      acc.values[i] += feature_weights[feature][i];
+  }
+  inline void SubtractFeature(int feature, NnueAccumulator& acc) const {
+    for (int i = 0; i < kNnueHiddenSize; ++i)
+      acc.values[i] -= feature_weights[feature][i];
+  }
+
+  static NnueFileHeader ExpectedHeader() {
+    NnueFileHeader header;
+    std::memcpy(header.magic, kNnueFileMagic, 8);
+    header.R = R;
+    header.C = C;
+    header.num_features = NumNnueFeatures<R, C>();
+    header.hidden_size = kNnueHiddenSize;
+    return header;
+  }
+};
+
+}  // namespace wallwars
+
+#endif  // NNUE_H_
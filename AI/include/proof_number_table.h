@@ -0,0 +1,140 @@
+#ifndef PROOF_NUMBER_TABLE_H_
+#define PROOF_NUMBER_TABLE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "constants.h"
+#include "move.h"
+#include "situation.h"
+#include "transposition_table.h"
+
+namespace wallwars {
+
+// Game-theoretic result of a situation for the player to move. See
+// `Negamax::Solve`.
+enum class SolveOutcome { kWin, kDraw, kLoss, kUnknown };
+
+inline std::string SolveOutcomeName(SolveOutcome outcome) {
+  switch (outcome) {
+    case SolveOutcome::kWin:
+      return "win";
+    case SolveOutcome::kDraw:
+      return "draw";
+    case SolveOutcome::kLoss:
+      return "loss";
+    default:
+      return "unknown";
+  }
+}
+
+struct SolveResult {
+  SolveOutcome outcome = SolveOutcome::kUnknown;
+  // For a win or a draw, a move that achieves it.
+  Move move;
+  // Number of nodes expanded by the proof-number searches.
+  long long num_nodes = 0;
+};
+
+// Proof and disproof numbers at least this large are infinite, i.e., the
+// goal of the search is disproved or proved, respectively.
+constexpr uint32_t kInfiniteProofNumber =
+    std::numeric_limits<uint32_t>::max() / 2;
+
+// Entries are for a situation with a number of plies left. The proof and
+// disproof numbers are for the goal of the search, not for the player to move.
+template <int R, int C>
+struct ProofNumberEntry {
+  Situation<R, C> sit;
+  uint32_t proof;
+  uint32_t disproof;
+  // Number of nodes expanded to compute the numbers. Entries with more work
+  // are kept over entries with less.
+  uint32_t work;
+  int8_t plies_left;
+  // Index of the goal of the search. See `ProofNumberTable::Lookup`.
+  int8_t goal;
+  // Query in which the entry was written. See `ProofNumberTable::NewQuery`.
+  // Query 0 is never live, so default-initialized entries count as empty.
+  uint8_t query = 0;
+};
+
+template <int R, int C>
+constexpr std::size_t NumProofNumberEntries() {
+  return kProofNumberTableMB * 1024LL * 1024LL / sizeof(ProofNumberEntry<R, C>);
+}
+
+// The transposition table of `Negamax::Solve`, separate from the one of the
+// search since the entries hold proof numbers instead of evals. There is one
+// entry per location. A situation goes to a location given by its hash and the
+// goal, whatever the plies left, so that a proof for fewer plies left can be
+// found by a search with more.
+template <int R, int C>
+class ProofNumberTable {
+ public:
+  ProofNumberTable() : entries_(NumProofNumberEntries<R, C>()) {}
+
+  // Makes every entry count as empty in O(1).
+  void NewQuery() {
+    if (query_ == std::numeric_limits<uint8_t>::max()) {
+      std::fill(entries_.begin(), entries_.end(), ProofNumberEntry<R, C>{});
+      query_ = 0;
+    }
+    ++query_;
+  }
+
+  // Sets `proof` and `disproof` to the numbers of `sit`, with hash `hash`,
+  // with `plies_left` plies left, for the goal with index `goal`. Searches for
+  // different goals, e.g., a win for either player, share the table. A proof
+  // with fewer plies left also holds with more, and a disproof with more plies
+  // left also holds with fewer. Returns false, and leaves the numbers
+  // unchanged, if there is no usable entry.
+  bool Lookup(uint64_t hash, int goal, const Situation<R, C>& sit,
+              int plies_left, uint32_t& proof, uint32_t& disproof) const {
+    const ProofNumberEntry<R, C>& entry = entries_[Location(hash, goal)];
+    if (entry.query != query_ || entry.goal != goal || entry.sit != sit)
+      return false;
+    if (entry.plies_left == plies_left ||
+        (entry.proof == 0 && entry.plies_left < plies_left) ||
+        (entry.disproof == 0 && entry.plies_left > plies_left)) {
+      proof = entry.proof;
+      disproof = entry.disproof;
+      return true;
+    }
+    return false;
+  }
+
+  // Replacement policy: an entry is replaced if it is empty, it is for the
+  // same situation and goal, or it took at most as much work.
+  void Store(uint64_t hash, int goal, const Situation<R, C>& sit,
+             int plies_left, uint32_t proof, uint32_t disproof, uint32_t work) {
+    ProofNumberEntry<R, C>& entry = entries_[Location(hash, goal)];
+    if (entry.query == query_ && (entry.goal != goal || entry.sit != sit) &&
+        entry.work > work)
+      return;
+    entry.sit = sit;
+    entry.proof = proof;
+    entry.disproof = disproof;
+    entry.work = work;
+    entry.plies_left = static_cast<int8_t>(plies_left);
+    entry.goal = static_cast<int8_t>(goal);
+    entry.query = query_;
+  }
+
+ private:
+  static std::size_t Location(uint64_t hash, int goal) {
+    uint64_t goal_state = goal;
+    return (hash ^ SplitMix64(goal_state)) % NumProofNumberEntries<R, C>();
+  }
+
+  std::vector<ProofNumberEntry<R, C>> entries_;
+  uint8_t query_ = 1;
+};
+
+}  // namespace wallwars
+
+#endif  // PROOF_NUMBER_TABLE_H_
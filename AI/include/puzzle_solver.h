@@ -0,0 +1,68 @@
+#ifndef PUZZLE_SOLVER_H_
+#define PUZZLE_SOLVER_H_
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "constants.h"
+#include "negamax.h"
+#include "proof_number_table.h"
+#include "situation.h"
+#include "utils.h"
+
+namespace wallwars {
+
+namespace puzzle_solver_internal {
+
+template <int R, int C>
+void SolveAndPrint(const std::string& standard_notation, long long max_nodes) {
+  Situation<R, C> sit = ParseSituationOrCrash<R, C>(standard_notation);
+  Negamax<R, C> negamaxer;
+  auto start = std::chrono::high_resolution_clock::now();
+  SolveResult result = negamaxer.Solve(sit, max_nodes);
+  std::cout << "Outcome for P" << static_cast<int>(sit.turn) << ": "
+            << SolveOutcomeName(result.outcome) << std::endl;
+  if (result.outcome == SolveOutcome::kWin ||
+      result.outcome == SolveOutcome::kDraw) {
+    std::cout << "Move: " << sit.MoveToStandardNotation(result.move)
+              << std::endl;
+  }
+  std::cout << "Nodes: " << result.num_nodes << std::endl
+            << "Time (ms): " << MillisSince(start) << std::endl;
+}
+
+}  // namespace puzzle_solver_internal
+
+// Solves the situation after `standard_notation` in a `rows`x`cols` board,
+// e.g., a puzzle, with `Negamax::Solve`, and prints the outcome, the move that
+// achieves it, and the cost. Only the board sizes of the benchmark situations
+// are compiled in. Returns false if the board size is not one of them.
+bool SolvePuzzle(int rows, int cols, const std::string& standard_notation,
+                 long long max_nodes = kSolveMaxNodes) {
+  using namespace puzzle_solver_internal;
+  if (rows == 3 && cols == 7) {
+    SolveAndPrint<3, 7>(standard_notation, max_nodes);
+  } else if (rows == 4 && cols == 4) {
+    SolveAndPrint<4, 4>(standard_notation, max_nodes);
+  } else if (rows == 4 && cols == 5) {
+    SolveAndPrint<4, 5>(standard_notation, max_nodes);
+  } else if (rows == 5 && cols == 5) {
+    SolveAndPrint<5, 5>(standard_notation, max_nodes);
+  } else if (rows == 6 && cols == 9) {
+    SolveAndPrint<6, 9>(standard_notation, max_nodes);
+  } else if (rows == 8 && cols == 8) {
+    SolveAndPrint<8, 8>(standard_notation, max_nodes);
+  } else if (rows == 10 && cols == 12) {
+    SolveAndPrint<10, 12>(standard_notation, max_nodes);
+  } else {
+    std::cout << "Unsupported board size: " << rows << "x" << cols
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace wallwars
+
+#endif  // PUZZLE_SOLVER_H_
@@ -78,6 +78,19 @@ struct Situation {
     return true;
   }
 
+  // Parses `s`, a single move in standard notation for the player to move
+  // (e.g., "b3v c2>"). Returns whether it is parsed correctly and legal, in
+  // which case `move` is set to it.
+  bool StandardNotationToMove(const std::string& s, Move& move) {
+    size_t s_i = 0;
+    ParsedMove parsed_move;
+    if (!ParseMove(s, s_i, parsed_move) || !IsDoneParsing(s, s_i) ||
+        parsed_move.actions.empty())
+      return false;
+    move = ParsedMoveToMove(parsed_move);
+    return IsLegalMove(move);
+  }
+
   bool operator==(const Situation& rhs) const {
     return (tokens == rhs.tokens && turn == rhs.turn && G == rhs.G);
   }
@@ -190,6 +203,45 @@ struct Situation {
 
   inline int TokenToMove() const { return tokens[turn]; }
 
+  // Returns the mirror image of this situation: the board is mirrored
+  // left-to-right and the players swap roles. The starts and goals are
+  // symmetric under this transformation, so the two situations are equivalent
+  // except for the draw rule, which only applies to P0.
+  Situation Mirrored() const {
+    Situation mirrored;
+    mirrored.tokens = {static_cast<int8_t>(MirrorNode(C, tokens[1])),
+                       static_cast<int8_t>(MirrorNode(C, tokens[0]))};
+    mirrored.turn = turn == 0 ? 1 : 0;
+    mirrored.G.SetStartingGraph();
+    for (int edge = 0; edge < NumRealAndFakeEdges(R, C); ++edge) {
+      if (IsRealEdge(R, C, edge) && !G.edges[edge])
+        mirrored.G.DeactivateEdge(MirrorEdge(C, edge));
+    }
+    return mirrored;
+  }
+
+  // Equivalent to `Mirrored() == other`.
+  bool IsMirrorOf(const Situation& other) const {
+    if (turn == other.turn || tokens[0] != MirrorNode(C, other.tokens[1]) ||
+        tokens[1] != MirrorNode(C, other.tokens[0]))
+      return false;
+    return Mirrored().G == other.G;
+  }
+
+  // Translates `move`, played in this situation, to the equivalent move in
+  // `Mirrored()`.
+  Move MirrorMove(Move move) const {
+    const int from = tokens[turn];
+    Move mirrored;
+    mirrored.token_change =
+        MirrorNode(C, from + move.token_change) - MirrorNode(C, from);
+    for (int i = 0; i < 2; ++i) {
+      mirrored.edges[i] =
+          move.edges[i] == -1 ? -1 : MirrorEdge(C, move.edges[i]);
+    }
+    return mirrored;
+  }
+
   std::vector<Move> AllLegalMoves() const {
     Situation clone = *this;
     std::vector<Move> moves;
@@ -605,12 +657,15 @@ struct Situation {
   // Parses a string in standard notation into the list of individual moves.
   // Returns whether parsing succeeds, in which case `parsed_moves` contains
   // the list of moves and `notated_moves` contains the list of strings
-  // corresponding to the moves.
+  // corresponding to the moves. `first_move_number` is the number of the first
+  // move in `s`, which is not 1 if `s` continues an earlier list.
   bool ParseMoveList(const std::string& s,
                      std::vector<ParsedMove>& parsed_moves,
-                     std::vector<std::string>& notated_moves) {
+                     std::vector<std::string>& notated_moves,
+                     int first_move_number = 1) {
     size_t s_i = 0;
-    for (int move_index = 1; !IsDoneParsing(s, s_i); ++move_index) {
+    for (int move_index = first_move_number; !IsDoneParsing(s, s_i);
+         ++move_index) {
       std::string move_number = std::to_string(move_index) + ".";
       if (!ConsumeToken(move_number, s, s_i)) return false;
       ParsedMove parsed_move;
@@ -1,20 +1,32 @@
 #ifndef TESTS_H_
 #define TESTS_H_
 
+#include <algorithm>
 #include <array>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
 #include <functional>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <tuple>
 #include <vector>
 
 #include "constants.h"
+#include "eval_cache.h"
 #include "external/span.h"
+#include "game_session.h"
 #include "graph.h"
 #include "macro_utils.h"
+#include "mcts.h"
 #include "negamax.h"
+#include "nnue.h"
 #include "situation.h"
+#include "time_manager.h"
 #include "utils.h"
 
 namespace wallwars {
@@ -67,6 +79,7 @@ class Tests {
     RUN_TEST(GraphNodesAtDistance2Test);
     RUN_TEST(GraphShortestPathTest);
     RUN_TEST(GraphShortestPathWithOrientationsTest);
+    RUN_TEST(GraphEdgesInEveryShortestPathTest);
     RUN_TEST(GraphConnectedComponentsTest);
     RUN_TEST(GraphBridgesTest);
     RUN_TEST(GraphTwoEdgeConnectedComponentsTest);
@@ -74,10 +87,41 @@ class Tests {
 
     // Situation tests
     RUN_TEST(SituationIsLegalMoveTest);
+    RUN_TEST(SituationMirroredTest);
+
+    // Transposition table tests
+    RUN_TEST(TranspositionTableGenerationTest);
+    RUN_TEST(TranspositionTableTornEntryTest);
+    RUN_TEST(TranspositionTableMirrorHashTest);
+    RUN_TEST(TranspositionTableTruncatedSnapshotTest);
+
+    // Time manager tests
+    RUN_TEST(TimeManagerClockTimeLimitsTest);
+    RUN_TEST(TimeManagerStartNextIterationTest);
 
     // Negamax tests
     RUN_TEST(NegamaxOrderedMovesTest);
+    RUN_TEST(NegamaxMoveOrderingHeuristicsTest);
+    RUN_TEST(NegamaxStagedMovesTest);
     RUN_TEST(NegamaxGetMoveTest);
+    RUN_TEST(NegamaxLazySMPTest);
+    RUN_TEST(NegamaxYBWCTest);
+    RUN_TEST(NegamaxPruningTest);
+    RUN_TEST(NegamaxMirrorSharingTest);
+    RUN_TEST(NegamaxRootAlgorithmTest);
+    RUN_TEST(NegamaxTimeLimitTest);
+    RUN_TEST(NegamaxPonderTest);
+    RUN_TEST(NegamaxResumeFromTTTest);
+    RUN_TEST(NegamaxMultiPVTest);
+    RUN_TEST(NegamaxRaceSolverTest);
+    RUN_TEST(NegamaxSolveTest);
+    RUN_TEST(MctsTest);
+    RUN_TEST(NnueTest);
+    RUN_TEST(EvalCacheTest);
+    RUN_TEST(NegamaxETCTest);
+    RUN_TEST(NegamaxIIDTest);
+    RUN_TEST(NegamaxNullMoveTest);
+    RUN_TEST(GameSessionTest);
 
     std::cerr << std::endl
               << "===============================================" << std::endl
@@ -121,6 +165,30 @@ class Tests {
     return res;
   }
 
+  // Returns the evals at `depth` of the mirror image of `sit` with an empty
+  // TT and with the TT entries that a search of `sit` leaves, which it may
+  // read instead of its own. They differ if an entry is shared between the
+  // two situations even though their evals differ.
+  template <int R, int C>
+  std::array<int, 2> FreshAndMirrorSharedEvals(Negamax<R, C>& searcher,
+                                               const Situation<R, C>& sit,
+                                               int depth) {
+    constexpr int kInf = 2 * Negamax<R, C>::kGameOverEval;
+    const Situation<R, C> mirrored = sit.Mirrored();
+    std::array<int, 2> evals;
+    searcher.ClearTT();
+    searcher.SetRootSituation(mirrored);
+    // Not the root, which does not use the eval of its TT entry.
+    searcher.ID_depth = depth + 1;
+    evals[0] = searcher.NegamaxEval(depth, -kInf, kInf);
+    searcher.ClearTT();
+    searcher.SetRootSituation(sit);
+    searcher.NegamaxEval(depth, -kInf, kInf);
+    searcher.SetRootSituation(mirrored);
+    evals[1] = searcher.NegamaxEval(depth, -kInf, kInf);
+    return evals;
+  }
+
   // Tests
 
   bool GraphDistanceTest() {
@@ -290,6 +358,48 @@ class Tests {
     return true;
   }
 
+  bool GraphEdgesInEveryShortestPathTest() {
+    // Node indices as in `GraphShortestPathTest`. The edge to the right of node
+    // `v` has index 2*`v`, and the edge below it has index 2*`v`+1.
+    {
+      // The shortest path is unique, so every edge in it is returned.
+      Graph<4, 4> G = StartingGraph<4, 4>();
+      G.BuildFromString(
+          ".|. . ."
+          " +-+-+ "
+          ".|. . ."
+          " + + + "
+          ".|.|.|."
+          " + +-+ "
+          ". .|. .");
+      auto actual = G.EdgesInEveryShortestPath(0, 15);
+      auto expected = ExtendWithMinus1({1, 9, 17, 24, 19, 11, 10, 12, 15, 23});
+      ASSERT_EQ(actual, expected);
+    }
+    {
+      // Every path goes through the edge between 9 and 10.
+      Graph<4, 4> G = StartingGraph<4, 4>();
+      G.BuildFromString(
+          ". .|. ."
+          " + + + "
+          ". .|. ."
+          " + + + "
+          ". . . ."
+          " + + + "
+          ". .|. .");
+      auto actual = G.EdgesInEveryShortestPath(4, 7);
+      auto expected = ExtendWithMinus1({18});
+      ASSERT_EQ(actual, expected);
+    }
+    {
+      Graph<4, 4> G = StartingGraph<4, 4>();
+      auto actual = G.EdgesInEveryShortestPath(0, 15);
+      auto expected = ExtendWithMinus1({});
+      ASSERT_EQ(actual, expected);
+    }
+    return true;
+  }
+
   bool GraphShortestPathWithOrientationsTest() {
     {
       Graph<4, 4> G = StartingGraph<4, 4>();
@@ -771,6 +881,40 @@ class Tests {
     return true;
   }
 
+  bool SituationMirroredTest() {
+    Situation<4, 4> sit = StartingSituation<4, 4>();
+    sit.G.BuildFromString(
+        ".|. . ."
+        " + + + "
+        ". . . ."
+        " + + + "
+        ". . . ."
+        " + + + "
+        ". . . .");
+    sit.tokens = {5, 2};
+    Situation<4, 4> expected = StartingSituation<4, 4>();
+    expected.G.BuildFromString(
+        ". . .|."
+        " + + + "
+        ". . . ."
+        " + + + "
+        ". . . ."
+        " + + + "
+        ". . . .");
+    expected.tokens = {1, 6};
+    expected.turn = 1;
+    Situation<4, 4> mirrored = sit.Mirrored();
+    ASSERT_EQ((mirrored == expected), true);
+    ASSERT_EQ((mirrored.Mirrored() == sit), true);
+
+    Move move = WalkAndBuildMove(5, 6, 1);
+    ASSERT_EQ(sit.MirrorMove(move), WalkAndBuildMove(6, 5, 7));
+    sit.ApplyMove(move);
+    mirrored.ApplyMove(WalkAndBuildMove(6, 5, 7));
+    ASSERT_EQ((sit.Mirrored() == mirrored), true);
+    return true;
+  }
+
   bool NegamaxOrderedMovesTest() {
     // Case where the player can do a double-token move or a single move and
     // build a wall in the edge just crossed.
@@ -1056,6 +1200,138 @@ class Tests {
     return true;
   }
 
+  bool TranspositionTableGenerationTest() {
+    TranspositionTable<4, 4> TT;
+    Situation<4, 4> sit = StartingSituation<4, 4>();
+    std::size_t location = TT.Location(sit);
+    ASSERT_EQ(TT.IsEmpty(location), true);
+    TT.Insert(location, sit, kExactFlag, 3, 5, DoubleWalkMove(0, 8));
+    ASSERT_EQ(TT.Contains(location, sit), true);
+    ASSERT_EQ(TT.IsFromPreviousSearch(location), false);
+
+    // A new search keeps the entry, but it can be replaced by anything.
+    TT.NewSearch();
+    ASSERT_EQ(TT.Contains(location, sit), true);
+    ASSERT_EQ(TT.IsFromPreviousSearch(location), true);
+    Situation<4, 4> other_sit = sit;
+    other_sit.turn = 1;
+    ASSERT_EQ(TT.CanStore(location, other_sit, 1), true);
+
+    // Within a search, only entries at the same or lower depth are replaced.
+    TT.Insert(location, sit, kExactFlag, 3, 5, DoubleWalkMove(0, 8));
+    ASSERT_EQ(TT.CanStore(location, other_sit, 2), false);
+    ASSERT_EQ(TT.CanStore(location, other_sit, 3), true);
+    ASSERT_EQ(TT.CanStore(location, sit, 1), true);
+
+    // Clearing makes every entry count as empty.
+    TT.Clear();
+    ASSERT_EQ(TT.IsEmpty(location), true);
+    ASSERT_EQ(TT.Contains(location, sit), false);
+    return true;
+  }
+
+  bool TranspositionTableTornEntryTest() {
+    TranspositionTable<4, 4> TT;
+    Situation<4, 4> sit = StartingSituation<4, 4>();
+    const std::size_t location = TT.Location(sit);
+    TT.Insert(location, sit, kExactFlag, 3, 5, DoubleWalkMove(0, 8));
+    TTEntry<4, 4> entry;
+    ASSERT_EQ(TT.Probe(location, sit, false, entry), true);
+    ASSERT_EQ(entry.eval, 5);
+    // Another thread writing the eval of a different result is not done yet.
+    TT.Entry(location).eval = 7;
+    ASSERT_EQ(TT.Probe(location, sit, false, entry), false);
+    ASSERT_EQ(TT.Contains(location, sit), false);
+    // Same for the situation.
+    entry = TT.Entry(location);
+    entry.eval = 7;
+    TT.Store(location, entry);
+    ASSERT_EQ(TT.Contains(location, sit), true);
+    TT.Entry(location).sit.turn = 1;
+    sit.turn = 1;
+    ASSERT_EQ(TT.Contains(location, sit), false);
+    return true;
+  }
+
+  bool TranspositionTableTruncatedSnapshotTest() {
+    TranspositionTable<4, 4> TT;
+    Situation<4, 4> sit = StartingSituation<4, 4>();
+    const std::size_t location = TT.Location(sit);
+    TT.Insert(location, sit, kExactFlag, 3, 5, DoubleWalkMove(0, 8));
+    // A compatible header followed by only part of the entries.
+    const std::string file_name = "tt_truncated_snapshot_test.bin";
+    {
+      std::ofstream fout(file_name, std::ios::binary);
+      std::array<char, kTTSnapshotHeaderBytes> header_page{};
+      const TTSnapshotHeader header = TT.ExpectedSnapshotHeader();
+      std::memcpy(header_page.data(), &header, sizeof(header));
+      fout.write(header_page.data(), header_page.size());
+      fout.write(reinterpret_cast<const char*>(TT.entries),
+                 sizeof(TTEntry<4, 4>) * 16);
+    }
+    ASSERT_EQ(TT.Load(file_name), false);
+    std::remove(file_name.c_str());
+    // The table is unchanged.
+    ASSERT_EQ(TT.Contains(location, sit), true);
+    return true;
+  }
+
+  bool TranspositionTableMirrorHashTest() {
+    Situation<4, 4> sit = StartingSituation<4, 4>();
+    uint64_t mirror_hash = SituationMirrorHash(sit);
+    ASSERT_EQ(mirror_hash, SituationHash(sit.Mirrored()));
+    // The mirror hash can be updated incrementally like the regular hash.
+    for (Move move : {WalkAndBuildMove(0, 1, 9), DoubleBuildMove(2, 20),
+                      DoubleWalkMove(1, 9)}) {
+      mirror_hash ^= MoveHashDelta(sit, move, kMirroredZobristKeys<4, 4>);
+      sit.ApplyMove(move);
+      ASSERT_EQ(mirror_hash, SituationHash(sit.Mirrored()));
+    }
+    return true;
+  }
+
+  bool TimeManagerClockTimeLimitsTest() {
+    // 60 s left plus the safety margin, and an increment of 2 s.
+    TimeLimits limits = ClockTimeLimits(60000 + kClockSafetyMillis, 2000);
+    ASSERT_EQ(limits.soft_millis, 60000 / kClockMovesToGo + 1500);
+    ASSERT_EQ(limits.hard_millis, 60000 / kClockMaxFraction);
+    ASSERT_EQ(limits.stop_early, true);
+    // With a large increment, the soft limit is above the hard limit's cap,
+    // and the hard limit is raised to the soft limit.
+    limits = ClockTimeLimits(4000 + kClockSafetyMillis, 2000);
+    ASSERT_EQ(limits.soft_millis, 4000 / kClockMovesToGo + 1500);
+    ASSERT_EQ(limits.hard_millis, limits.soft_millis);
+    // The limits never exceed the remaining time.
+    limits = ClockTimeLimits(kClockSafetyMillis, 2000);
+    ASSERT_EQ(limits.soft_millis, 1);
+    ASSERT_EQ(limits.hard_millis, 1);
+    return true;
+  }
+
+  bool TimeManagerStartNextIterationTest() {
+    TimeManager time_manager;
+    // A fixed time only stops at the soft limit.
+    time_manager.Start(FixedTimeLimits(100000));
+    for (int i = 0; i < 2 * TimeManager::kStableIterations; ++i) {
+      ASSERT_EQ(time_manager.StartNextIteration(false), true);
+    }
+    time_manager.Start(FixedTimeLimits(0));
+    ASSERT_EQ(time_manager.StartNextIteration(true), false);
+    // The hard limit stops the search when it is polled.
+    ASSERT_EQ(time_manager.Stopped(), false);
+    time_manager.Poll();
+    ASSERT_EQ(time_manager.Stopped(), true);
+    // After 600 ms, a stable best move stops the search, since it is past the
+    // fraction of the soft limit.
+    time_manager.Start({1000, 100000, true});
+    std::this_thread::sleep_for(std::chrono::milliseconds(600));
+    for (int i = 1; i < TimeManager::kStableIterations; ++i) {
+      ASSERT_EQ(time_manager.StartNextIteration(false), true);
+    }
+    ASSERT_EQ(time_manager.StartNextIteration(false), false);
+    return true;
+  }
+
   bool NegamaxGetMoveTest() {
     Negamax<4, 4> negamaxer;
     // Case with only one legal move.
@@ -1100,6 +1376,814 @@ class Tests {
     }
     return true;
   }
+
+  bool NegamaxMoveOrderingHeuristicsTest() {
+    Negamax<4, 4> negamaxer;
+    negamaxer.ID_depth = 2;
+    negamaxer.sit_ = StartingSituation<4, 4>();
+    auto static_span = negamaxer.OrderedMoves(0);
+    std::vector<ScoredMove> static_order(static_span.begin(),
+                                         static_span.end());
+    // The last move whose legality is already checked.
+    Move killer;
+    for (const ScoredMove& scored_move : static_order) {
+      if (scored_move.score != Negamax<4, 4>::kPossiblyIllegalMoveScore)
+        killer = scored_move.move;
+    }
+    const Move refuted_move = static_order[0].move;
+    const Move countermove = static_order[static_order.size() / 2].move;
+    // A cutoff at ply 1 after `refuted_move`.
+    negamaxer.moves_to_ply_[1] = refuted_move;
+    negamaxer.RecordCutoff(killer, /*depth=*/1, /*ply=*/1);
+    auto span = negamaxer.OrderedMoves(0, /*ply=*/1);
+    ASSERT_EQ(span.size(), static_order.size());
+    ASSERT_EQ(span[0].move, killer);
+    // The countermove gets a bonus only after the move it refuted.
+    negamaxer.RecordCutoff(countermove, /*depth=*/1, /*ply=*/1);
+    span = negamaxer.OrderedMoves(0, /*ply=*/1);
+    ASSERT_EQ(span[0].move, countermove);
+    ASSERT_EQ(span[1].move, killer);
+    negamaxer.moves_to_ply_[1] = static_order[1].move;
+    span = negamaxer.OrderedMoves(0, /*ply=*/1);
+    ASSERT_EQ(span[0].move, countermove);
+    ASSERT_EQ((span[0].score - static_order[static_order.size() / 2].score <
+               Negamax<4, 4>::kFirstKillerBonus +
+                   Negamax<4, 4>::kCountermoveBonus),
+              true);
+    return true;
+  }
+
+  bool NegamaxStagedMovesTest() {
+    Negamax<4, 4> negamaxer;
+    negamaxer.sit_ = StartingSituation<4, 4>();
+    negamaxer.sit_.G.BuildFromString(
+        ". . . ."
+        " + + + "
+        ". .|. ."
+        " +-+ + "
+        ". . . ."
+        " + + + "
+        ". . . .");
+    auto span = negamaxer.OrderedMoves(0);
+    std::vector<ScoredMove> all_moves(span.begin(), span.end());
+    // The staged moves skip `searched_move`, and they are the same as the
+    // ordered moves otherwise.
+    const Move searched_move = all_moves[1].move;
+    all_moves.erase(all_moves.begin() + 1);
+    Negamax<4, 4>::StagedMoves staged_moves(negamaxer, /*depth=*/1,
+                                            /*ply=*/-1, {searched_move});
+    // `Peek` generates the first stage, which is the one `Get` starts with.
+    const ScoredMove* peeked_move = staged_moves.Peek(0);
+    ASSERT_EQ((peeked_move != nullptr), true);
+    const Move first_move = peeked_move->move;
+    const int num_generated_by_peek = staged_moves.NumGenerated();
+    ASSERT_EQ(staged_moves.Get(0)->move, first_move);
+    ASSERT_EQ(staged_moves.NumGenerated(), num_generated_by_peek);
+    // The first stage only has the double walks.
+    ASSERT_EQ((num_generated_by_peek < static_cast<int>(all_moves.size())),
+              true);
+    std::vector<ScoredMove> staged_order;
+    // The number of generated moves when each move was returned, which only
+    // changes from one stage to the next.
+    std::vector<int> num_generated;
+    while (const ScoredMove* scored_move =
+               staged_moves.Get(static_cast<int>(staged_order.size()))) {
+      staged_order.push_back(*scored_move);
+      num_generated.push_back(staged_moves.NumGenerated());
+    }
+    ASSERT_EQ(staged_moves.NumGenerated(), static_cast<int>(all_moves.size()));
+    ASSERT_EQ(staged_order.size(), all_moves.size());
+    ASSERT_EQ(staged_order[0].move, first_move);
+    // Moves are sorted within each stage.
+    for (std::size_t i = 1; i < staged_order.size(); ++i) {
+      if (num_generated[i] != num_generated[i - 1]) continue;
+      ASSERT_EQ((staged_order[i - 1].score >= staged_order[i].score), true);
+    }
+    auto by_move = [](const ScoredMove& lhs, const ScoredMove& rhs) {
+      return std::make_tuple(lhs.move.token_change, lhs.move.edges) <
+             std::make_tuple(rhs.move.token_change, rhs.move.edges);
+    };
+    std::sort(all_moves.begin(), all_moves.end(), by_move);
+    std::sort(staged_order.begin(), staged_order.end(), by_move);
+    ASSERT_EQ((staged_order == all_moves), true);
+    return true;
+  }
+
+  bool NegamaxLazySMPTest() {
+    Negamax<4, 4> negamaxer;
+    negamaxer.SetNumThreads(4);
+    Situation<4, 4> sit = StartingSituation<4, 4>();
+    // There is only one winning move.
+    sit.G.BuildFromString(
+        ". . . ."
+        " + + + "
+        ". . . ."
+        " + + + "
+        ". . . ."
+        " +-+-+ "
+        ". . . .");
+    sit.tokens = {12, 13};
+    Move actual = negamaxer.GetMove(sit, 1000);
+    Move expected = WalkAndBuildMove(12, 13, 24);
+    ASSERT_EQ(actual, expected);
+    // A search that runs out of time, so the helpers have to be stopped.
+    sit = StartingSituation<4, 4>();
+    actual = negamaxer.GetMove(sit, 200);
+    ASSERT_EQ(sit.IsLegalMove(actual), true);
+    return true;
+  }
+
+  bool NegamaxYBWCTest() {
+    Negamax<4, 4> negamaxer;
+    negamaxer.SetNumThreads(4, ParallelMode::kYBWC);
+    Situation<4, 4> sit = StartingSituation<4, 4>();
+    // There is only one winning move.
+    sit.G.BuildFromString(
+        ". . . ."
+        " + + + "
+        ". . . ."
+        " + + + "
+        ". . . ."
+        " +-+-+ "
+        ". . . .");
+    sit.tokens = {12, 13};
+    Move actual = negamaxer.GetMove(sit, 1000);
+    Move expected = WalkAndBuildMove(12, 13, 24);
+    ASSERT_EQ(actual, expected);
+    // A search that stops at a fixed depth.
+    sit = StartingSituation<4, 4>();
+    actual = negamaxer.GetMove(sit, 10000, 4);
+    ASSERT_EQ(negamaxer.ID_depth, 5);
+    ASSERT_EQ(sit.IsLegalMove(actual), true);
+    // A search that runs out of time, so some root tasks are skipped.
+    negamaxer.ClearTT();
+    actual = negamaxer.GetMove(sit, 200);
+    ASSERT_EQ(sit.IsLegalMove(actual), true);
+    return true;
+  }
+
+  bool NegamaxPruningTest() {
+    Situation<4, 4> sit = StartingSituation<4, 4>();
+    // There is only one winning move.
+    sit.G.BuildFromString(
+        ". . . ."
+        " + + + "
+        ". . . ."
+        " + + + "
+        ". . . ."
+        " +-+-+ "
+        ". . . .");
+    sit.tokens = {12, 13};
+    for (bool lmr : {false, true}) {
+      for (bool futility : {false, true}) {
+        Negamax<4, 4> negamaxer;
+        negamaxer.SetLateMoveReductions(lmr);
+        negamaxer.SetFutilityPruning(futility);
+        Move actual = negamaxer.GetMove(sit, 1000);
+        ASSERT_EQ(actual, WalkAndBuildMove(12, 13, 24));
+        // Reductions skip plies, but the ply is restored after the search.
+        actual = negamaxer.GetMove(StartingSituation<4, 4>(), 10000, 5);
+        ASSERT_EQ(negamaxer.ply_, 0);
+      }
+    }
+    // The static eval of the starting situation is 0.
+    Negamax<4, 4> negamaxer;
+    negamaxer.sit_ = StartingSituation<4, 4>();
+    const int margin = Negamax<4, 4>::kFutilityMargin;
+    ASSERT_EQ(negamaxer.FutilityEval(/*depth=*/1, /*alpha=*/5), margin);
+    ASSERT_EQ((negamaxer.FutilityEval(/*depth=*/1, /*alpha=*/2) > 2), true);
+
+    // P0 is next to its goal, but every edge is a bridge, so it cannot build
+    // the wall that its move needs besides the step to the goal.
+    Situation<4, 4> comb = StartingSituation<4, 4>();
+    comb.G.BuildFromString(
+        ". . . ."
+        " +-+-+-"
+        ". . . ."
+        " +-+-+-"
+        ". . . ."
+        " +-+-+-"
+        ". . . .");
+    comb.tokens = {14, 3};
+    const int kInf = 2 * Negamax<4, 4>::kGameOverEval;
+    negamaxer.SetRootSituation(comb);
+    ASSERT_EQ(negamaxer.QuiescenceEval(-kInf, kInf), 6 - 1);
+    // With a cycle, it can build a wall and win.
+    comb.G.ActivateEdge(EdgeBelow(4, 4, 3));
+    negamaxer.SetRootSituation(comb);
+    ASSERT_EQ(negamaxer.QuiescenceEval(-kInf, kInf),
+              (Negamax<4, 4>::kGameOverEval - 1));
+    return true;
+  }
+
+  bool NegamaxMirrorSharingTest() {
+    // P0 is at distance 2 of its goal, and P1, which is to move, at distance
+    // 4. At the horizon of a search of depth 1, the quiescence search claims
+    // the win of P0, but it is a draw since P1 can walk within distance 2 of
+    // its goal. In the mirror image, P1 claims the win, which the draw rule
+    // does not stop.
+    Situation<3, 4> sit = StartingSituation<3, 4>();
+    sit.G.BuildFromString(
+        ".|.|. ."
+        " +-+ + "
+        ". .|.|."
+        "-+ +-+ "
+        ". . .|.");
+    sit.tokens = {3, 0};
+    sit.turn = 1;
+    Negamax<3, 4> negamaxer;
+    std::array<int, 2> evals = FreshAndMirrorSharedEvals(negamaxer, sit, 1);
+    ASSERT_EQ(evals[1], evals[0]);
+
+    // The players are separated. P0, which is to move, is at distance 4 of
+    // its goal, and P1 at distance 3. After the move of P0, the race solver
+    // finds that P0 arrives first, but that P1 gets a draw, beyond the depth
+    // of the search. In the mirror image, P1 arrives first and wins.
+    Situation<4, 4> race = StartingSituation<4, 4>();
+    race.G.BuildFromString(
+        ".|.|. ."
+        "-+ +-+ "
+        ".|.|.|."
+        "-+ + + "
+        ". .|.|."
+        "-+ +-+ "
+        ". .|. .");
+    race.tokens = {2, 5};
+    Negamax<4, 4> race_negamaxer;
+    race_negamaxer.SetQuiescenceSearch(false);
+    evals = FreshAndMirrorSharedEvals(race_negamaxer, race, 2);
+    ASSERT_EQ(evals[1], evals[0]);
+    return true;
+  }
+
+  bool NegamaxRootAlgorithmTest() {
+    Situation<4, 4> sit = StartingSituation<4, 4>();
+    // There is only one winning move.
+    sit.G.BuildFromString(
+        ". . . ."
+        " + + + "
+        ". . . ."
+        " + + + "
+        ". . . ."
+        " +-+-+ "
+        ". . . .");
+    sit.tokens = {12, 13};
+    Negamax<4, 4> mtdf;
+    mtdf.SetRootAlgorithm(RootAlgorithm::kMTDf);
+    ASSERT_EQ(mtdf.GetMove(sit, 1000), WalkAndBuildMove(12, 13, 24));
+    // Without pruning, both algorithms find the exact eval at each depth.
+    for (int depth = 1; depth <= 5; ++depth) {
+      int evals[2];
+      for (RootAlgorithm algorithm :
+           {RootAlgorithm::kAlphaBeta, RootAlgorithm::kMTDf}) {
+        Negamax<4, 4> negamaxer;
+        negamaxer.SetRootAlgorithm(algorithm);
+        negamaxer.SetLateMoveReductions(false);
+        negamaxer.SetFutilityPruning(false);
+        negamaxer.SetQuiescenceSearch(false);
+        negamaxer.GetMove(StartingSituation<4, 4>(), 10000, depth);
+        evals[algorithm == RootAlgorithm::kMTDf] = negamaxer.root_eval_;
+      }
+      ASSERT_EQ(evals[0], evals[1]);
+    }
+    return true;
+  }
+
+  bool NegamaxTimeLimitTest() {
+    // On an empty 8x8 board, depth 4 takes much longer than the time limit, so
+    // the search is aborted in the middle of a root move.
+    Negamax<8, 8> negamaxer;
+    const auto start = std::chrono::high_resolution_clock::now();
+    Move actual = negamaxer.GetMove(StartingSituation<8, 8>(), 300);
+    ASSERT_EQ((MillisSince(start) < 1000), true);
+    ASSERT_EQ((StartingSituation<8, 8>().IsLegalMove(actual)), true);
+    ASSERT_EQ(negamaxer.ply_, 0);
+    return true;
+  }
+
+  bool NegamaxPonderTest() {
+    Negamax<4, 4> negamaxer;
+    Situation<4, 4> sit = StartingSituation<4, 4>();
+    sit.ApplyMove(negamaxer.GetMove(sit, 100));
+    // The expected reply is the best move found for the opponent.
+    negamaxer.StartPondering(sit);
+    ASSERT_EQ(negamaxer.ponder_thread_.joinable(), true);
+    const Situation<4, 4> ponder_sit = negamaxer.ponder_sit_;
+    ASSERT_EQ((ponder_sit.turn != sit.turn), true);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    // On a ponder hit, the search continues and the move is for the pondered
+    // situation.
+    Move actual = negamaxer.GetMove(ponder_sit, 100);
+    ASSERT_EQ(negamaxer.ponder_thread_.joinable(), false);
+    ASSERT_EQ(ponder_sit.IsLegalMove(actual), true);
+    // On a miss, the ponder search is discarded.
+    negamaxer.StartPondering(sit);
+    ASSERT_EQ(negamaxer.ponder_thread_.joinable(), true);
+    Situation<4, 4> other_sit = StartingSituation<4, 4>();
+    actual = negamaxer.GetMove(other_sit, 100);
+    ASSERT_EQ(negamaxer.ponder_thread_.joinable(), false);
+    ASSERT_EQ(other_sit.IsLegalMove(actual), true);
+    ASSERT_EQ(negamaxer.ply_, 0);
+    // The destructor stops pondering.
+    negamaxer.StartPondering(sit);
+    return true;
+  }
+
+  bool NegamaxResumeFromTTTest() {
+    Negamax<8, 8> negamaxer;
+    negamaxer.SetResumeFromTT(true);
+    Situation<8, 8> sit = StartingSituation<8, 8>();
+    // The search leaves TT entries along the principal variation, so, two
+    // plies later, the search resumes from depth 3 - 2 + 1.
+    sit.ApplyMove(negamaxer.GetMove(sit, 100000, 3));
+    negamaxer.SetRootSituation(sit);
+    const auto tt_key = negamaxer.CurrentTTKey();
+    sit.ApplyMove(
+        negamaxer.MoveInTTEntry(negamaxer.TT.Entry(tt_key.location), tt_key));
+    negamaxer.SetRootSituation(sit);
+    ASSERT_EQ(negamaxer.ResumeDepth(kMaxDepth), 2);
+    ASSERT_EQ(sit.IsLegalMove(negamaxer.root_move_), true);
+
+    // Killers move closer to the root as the root advances.
+    const Move killer = negamaxer.root_move_;
+    negamaxer.tables_->killers[2][0] = killer;
+    negamaxer.ShiftKillers(2);
+    ASSERT_EQ((negamaxer.tables_->killers[0][0] == killer), true);
+    ASSERT_EQ((negamaxer.tables_->killers[2][0] == Move()), true);
+    negamaxer.tables_->killers[0][0] = killer;
+    negamaxer.ShiftKillers(-1);
+    ASSERT_EQ((negamaxer.tables_->killers[0][0] == Move()), true);
+    return true;
+  }
+
+  bool NegamaxMultiPVTest() {
+    const Situation<5, 5> sit = StartingSituation<5, 5>();
+    Negamax<5, 5> single_pv;
+    const Move best_move = single_pv.GetMove(sit, 100000, 3);
+    Negamax<5, 5> multi_pv;
+    std::vector<RankedMove> top_moves = multi_pv.GetTopMoves(sit, 3, 100000, 3);
+    ASSERT_EQ(top_moves.size(), 3u);
+    // The first pass is the same search as without multi-PV.
+    ASSERT_EQ((top_moves[0].move == best_move), true);
+    ASSERT_EQ(top_moves[0].eval, single_pv.root_eval_);
+    for (std::size_t i = 0; i < top_moves.size(); ++i) {
+      if (i > 0) {
+        ASSERT_EQ((top_moves[i].eval <= top_moves[i - 1].eval), true);
+        ASSERT_EQ((top_moves[i].move != top_moves[i - 1].move), true);
+      }
+      ASSERT_EQ((top_moves[i].pv.front() == top_moves[i].move), true);
+      ASSERT_EQ((top_moves[i].pv.size() <= 3u), true);
+      Situation<5, 5> pv_sit = sit;
+      for (const Move& move : top_moves[i].pv) {
+        ASSERT_EQ(pv_sit.IsLegalMove(move), true);
+        pv_sit.ApplyMove(move);
+      }
+    }
+    // The TT entry of the root is still the one of the best move.
+    ASSERT_EQ((multi_pv.GetMove(sit, 100000, 1) == best_move), true);
+    ASSERT_EQ(multi_pv.ply_, 0);
+    // A single ranked move is the best move.
+    top_moves = multi_pv.GetTopMoves(sit, 1, 100000, 3);
+    ASSERT_EQ(top_moves.size(), 1u);
+    ASSERT_EQ((top_moves[0].move == best_move), true);
+    // A search stopped during the first pass at depth 1 ranks no moves.
+    Negamax<5, 5> stopped;
+    stopped.SetRootSituation(sit);
+    stopped.num_pvs_ = 3;
+    stopped.ID_depth = 1;
+    stopped.time_manager_->Stop();
+    stopped.MultiPVRootSearch();
+    ASSERT_EQ(stopped.ranked_moves_.empty(), true);
+    ASSERT_EQ(stopped.search_interrupted, true);
+    return true;
+  }
+
+  bool NegamaxRaceSolverTest() {
+    // Each player is alone in a corridor with its goal, and the middle columns
+    // have plenty of walls to build.
+    Situation<5, 5> sit = StartingSituation<5, 5>();
+    sit.G.BuildFromString(
+        ".|. . .|."
+        " + + + + "
+        ".|. . .|."
+        " + + + + "
+        ".|. . .|."
+        " + + + + "
+        ".|. . .|."
+        " + + + + "
+        ".|. . .|.");
+    Negamax<5, 5> solver;
+    Negamax<5, 5> searcher;
+    searcher.SetRaceSolver(false);
+    constexpr int kDepth = 5;
+    constexpr int kWin = Negamax<5, 5>::kGameOverEval + kDepth;
+    // {P0 token, P1 token, turn, eval at depth `kDepth`}.
+    const std::vector<std::array<int, 4>> races = {
+        // P0 arrives first, but P1 is within 2 of its goal: draw.
+        {4, 0, 0, 0},
+        // P1 arrives first, in its second move (ply 3).
+        {4, 0, 1, kWin - 3},
+        // P0 arrives in its first move, and P1 is too far for a draw.
+        {14, 0, 0, kWin - 1},
+        // P0 needs a move that walks one step and builds a wall.
+        {19, 0, 0, kWin - 1},
+        // Both players are at distance 3. The player to move arrives first, in
+        // its second move, but if it is P0, P1 is within 2 of its goal.
+        {9, 5, 1, kWin - 3},
+        {9, 5, 0, 0},
+    };
+    for (const auto& race : races) {
+      sit.tokens = {static_cast<int8_t>(race[0]), static_cast<int8_t>(race[1])};
+      sit.turn = race[2];
+      solver.SetRootSituation(sit);
+      int eval;
+      Move move;
+      ASSERT_EQ(solver.SolveRace(kDepth, eval, &move), true);
+      ASSERT_EQ(eval, race[3]);
+      ASSERT_EQ(sit.IsLegalMove(move), true);
+      // Same eval as the search.
+      searcher.ClearTT();
+      searcher.SetRootSituation(sit);
+      searcher.ID_depth = kDepth;
+      ASSERT_EQ(searcher.NegamaxEval(kDepth, -2 * kWin, 2 * kWin), race[3]);
+      ASSERT_EQ((solver.GetMove(sit, 100000) == move), true);
+    }
+
+    // Not a race: the players are not separated.
+    solver.SetRootSituation(StartingSituation<5, 5>());
+    int eval;
+    ASSERT_EQ(solver.SolveRace(kDepth, eval), false);
+    // Not a race: P0 could be forced to take a longer path.
+    sit.G.ActivateEdge(EdgeRight(5, 8));
+    sit.G.ActivateEdge(EdgeRight(5, 18));
+    sit.tokens = {4, 0};
+    solver.SetRootSituation(sit);
+    ASSERT_EQ(solver.SolveRace(kDepth, eval), false);
+    return true;
+  }
+
+  bool NegamaxSolveTest() {
+    // The player to move wins Puzzle6, and then loses.
+    Situation<4, 5> puzzle = ParseSituationOrCrash<4, 5>(
+        "1. b2 2. d2 3. a4> b3v 4. b2v b2> 5. d3v d4> 6. d2v d2> 7. b4> c4> "
+        "8. a2> c2>");
+    Negamax<4, 5> puzzle_solver;
+    SolveResult result = puzzle_solver.Solve(puzzle);
+    ASSERT_EQ((result.outcome == SolveOutcome::kWin), true);
+    ASSERT_EQ(puzzle.IsLegalMove(result.move), true);
+    ASSERT_EQ((result.num_nodes > 0), true);
+    puzzle.ApplyMove(result.move);
+    ASSERT_EQ((puzzle_solver.Solve(puzzle).outcome == SolveOutcome::kLoss),
+              true);
+
+    // The races of `NegamaxRaceSolverTest`, solved by the proof-number search
+    // and by the race solver.
+    Situation<5, 5> sit = StartingSituation<5, 5>();
+    sit.G.BuildFromString(
+        ".|. . .|."
+        " + + + + "
+        ".|. . .|."
+        " + + + + "
+        ".|. . .|."
+        " + + + + "
+        ".|. . .|."
+        " + + + + "
+        ".|. . .|.");
+    Negamax<5, 5> race_solver;
+    Negamax<5, 5> dfpn_solver;
+    dfpn_solver.SetRaceSolver(false);
+    // {P0 token, P1 token, turn}, and the outcome.
+    const std::vector<std::pair<std::array<int, 3>, SolveOutcome>> races = {
+        {{4, 0, 0}, SolveOutcome::kDraw},
+        {{4, 0, 1}, SolveOutcome::kWin},
+        {{14, 0, 0}, SolveOutcome::kWin},
+        {{9, 5, 0}, SolveOutcome::kDraw},
+    };
+    for (const auto& race : races) {
+      sit.tokens = {static_cast<int8_t>(race.first[0]),
+                    static_cast<int8_t>(race.first[1])};
+      sit.turn = race.first[2];
+      for (Negamax<5, 5>* solver : {&race_solver, &dfpn_solver}) {
+        result = solver->Solve(sit, 100000, 6);
+        ASSERT_EQ((result.outcome == race.second), true);
+        ASSERT_EQ(sit.IsLegalMove(result.move), true);
+      }
+      // The race solver needs no search.
+      ASSERT_EQ(race_solver.Solve(sit).num_nodes, 0);
+    }
+    // Out of budget.
+    result = dfpn_solver.Solve(StartingSituation<5, 5>(), 100);
+    ASSERT_EQ((result.outcome == SolveOutcome::kUnknown), true);
+    ASSERT_EQ(result.num_nodes, 100);
+    return true;
+  }
+
+  bool MctsTest() {
+    // The corridors of `NegamaxRaceSolverTest`.
+    Situation<5, 5> sit = StartingSituation<5, 5>();
+    sit.G.BuildFromString(
+        ".|. . .|."
+        " + + + + "
+        ".|. . .|."
+        " + + + + "
+        ".|. . .|."
+        " + + + + "
+        ".|. . .|."
+        " + + + + "
+        ".|. . .|.");
+    Mcts<5, 5> mcts;
+    // P0 arrives in its first move.
+    sit.tokens = {14, 0};
+    sit.turn = 0;
+    Situation<5, 5> after_move = sit;
+    after_move.ApplyMove(mcts.GetMove(sit, 100000, 100));
+    ASSERT_EQ(after_move.Winner(), 0);
+    // P1 arrives first, in its second move, unless it lets P0 build walls.
+    sit.tokens = {4, 0};
+    sit.turn = 1;
+    after_move = sit;
+    after_move.ApplyMove(mcts.GetMove(sit, 100000, 2000));
+    Negamax<5, 5> solver;
+    ASSERT_EQ((solver.Solve(after_move).outcome == SolveOutcome::kLoss), true);
+
+    // Tree-parallel playouts release their virtual losses.
+    mcts.SetNumThreads(2);
+    global_metrics = {};
+    sit = StartingSituation<5, 5>();
+    ASSERT_EQ(sit.IsLegalMove(mcts.GetMove(sit, 100000, 500)), true);
+    ASSERT_EQ(global_metrics.mcts_playouts, 500);
+    ASSERT_EQ(mcts.root_->visits, 500);
+    int children_visits = 0;
+    for (int i = 0; i < mcts.root_->num_children; ++i) {
+      children_visits += mcts.root_->children[i].visits;
+      ASSERT_EQ(mcts.root_->children[i].virtual_losses, 0);
+    }
+    ASSERT_EQ(children_visits, 500);
+    return true;
+  }
+
+  bool NnueTest() {
+    Situation<5, 5> sit = StartingSituation<5, 5>();
+    std::shared_ptr<const NnueWeights<5, 5>> weights =
+        NnueWeights<5, 5>::Random(1);
+    Negamax<5, 5> negamaxer;
+    negamaxer.SetRootSituation(sit);
+    const int distance_eval = negamaxer.LeafEval();
+    negamaxer.SetNnue(weights);
+    negamaxer.SetRootSituation(sit);
+    const NnueAccumulator root_accumulator = negamaxer.nnue_accumulator_;
+    ASSERT_EQ(negamaxer.LeafEval(),
+              distance_eval + weights->Evaluate(root_accumulator));
+
+    // The incremental updates match the accumulator computed from scratch,
+    // with walk moves and with double-build moves.
+    std::vector<Move> moves;
+    for (int i = 0; i < 8 && !negamaxer.sit_.IsGameOver(); ++i) {
+      nonstd::span<const ScoredMove> ordered = negamaxer.OrderedMoves(0);
+      Move move = ordered[0].move;
+      for (std::size_t j = ordered.size() - 1; j > 0; --j) {
+        if (i % 2 == 1 && negamaxer.sit_.IsLegalMove(ordered[j].move)) {
+          move = ordered[j].move;
+          break;
+        }
+      }
+      negamaxer.ApplyMove(move);
+      moves.push_back(move);
+      NnueAccumulator refreshed;
+      weights->Refresh(negamaxer.sit_, refreshed);
+      ASSERT_EQ((negamaxer.nnue_accumulator_ == refreshed), true);
+      ASSERT_EQ(weights->Evaluate(refreshed),
+                weights->EvaluateScalar(refreshed));
+    }
+    for (auto it = moves.rbegin(); it != moves.rend(); ++it)
+      negamaxer.UndoMove(*it);
+    ASSERT_EQ((negamaxer.nnue_accumulator_ == root_accumulator), true);
+    ASSERT_EQ(sit.IsLegalMove(negamaxer.GetMove(sit, 100000, 3)), true);
+
+    // The network is not mirror-symmetric, so a situation and its mirror image
+    // do not share TT entries: the eval of the mirror image is the same with
+    // and without the entries of the situation. Without NNUE, the pair
+    // evaluates equal.
+    constexpr int kDepth = 2;
+    constexpr int kInf = 2 * Negamax<5, 5>::kGameOverEval;
+    const Situation<5, 5> mirrored = sit.Mirrored();
+    Negamax<5, 5> distance_only;
+    std::array<int, 2> evals;
+    for (Negamax<5, 5>* searcher : {&negamaxer, &distance_only}) {
+      searcher->ClearTT();
+      searcher->SetRootSituation(mirrored);
+      // Not the root, which does not use the eval of its TT entry.
+      searcher->ID_depth = kDepth + 1;
+      const int fresh_eval = searcher->NegamaxEval(kDepth, -kInf, kInf);
+      searcher->ClearTT();
+      for (int i = 0; i < 2; ++i) {
+        searcher->SetRootSituation(i == 0 ? sit : mirrored);
+        evals[i] = searcher->NegamaxEval(kDepth, -kInf, kInf);
+      }
+      ASSERT_EQ(evals[1], fresh_eval);
+    }
+    ASSERT_EQ(evals[0], evals[1]);
+
+    // Weights files.
+    const std::string file_name = "nnue_test_weights.bin";
+    ASSERT_EQ(weights->Save(file_name), true);
+    NnueWeights<5, 5> loaded = *NnueWeights<5, 5>::Random(2);
+    ASSERT_EQ(loaded.Load(file_name), true);
+    ASSERT_EQ(loaded.Evaluate(root_accumulator),
+              weights->Evaluate(root_accumulator));
+    ASSERT_EQ((loaded.feature_weights == weights->feature_weights), true);
+    Negamax<4, 4> other_size;
+    ASSERT_EQ(other_size.LoadNnue(file_name), false);
+    std::remove(file_name.c_str());
+    ASSERT_EQ(negamaxer.LoadNnue(file_name), false);
+    return true;
+  }
+
+  bool EvalCacheTest() {
+    EvalCache cache;
+    std::array<int, 2> goal_distances = {-1, -1};
+    ASSERT_EQ(cache.Probe(12345, goal_distances), false);
+    cache.Store(12345, {7, 120});
+    ASSERT_EQ(cache.Probe(12345, goal_distances), true);
+    ASSERT_EQ(goal_distances[0], 7);
+    ASSERT_EQ(goal_distances[1], 120);
+    // A different key for the same location.
+    ASSERT_EQ(cache.Probe(12345 + kEvalCacheEntries, goal_distances), false);
+
+    // The key does not depend on the turn.
+    Situation<5, 5> sit = StartingSituation<5, 5>();
+    Negamax<5, 5> negamaxer;
+    negamaxer.SetRootSituation(sit);
+    const uint64_t key = negamaxer.PositionKey();
+    sit.turn = 1;
+    negamaxer.SetRootSituation(sit);
+    ASSERT_EQ(negamaxer.PositionKey(), key);
+    const std::array<int, 2> expected = {
+        sit.G.Distance(sit.tokens[0], Goals(5, 5)[0]),
+        sit.G.Distance(sit.tokens[1], Goals(5, 5)[1])};
+    ASSERT_EQ((negamaxer.GoalDistances() == expected), true);
+    global_metrics = {};
+    ASSERT_EQ(negamaxer.LeafEval(), expected[1] - expected[0]);
+    if (kBenchmark) ASSERT_EQ(global_metrics.eval_cache_hits, 1);
+
+    // Same search with and without the cache.
+    sit.turn = 0;
+    Negamax<5, 5> with_cache;
+    Negamax<5, 5> without_cache;
+    without_cache.SetEvalCache(false);
+    constexpr int kDepth = 4;
+    constexpr int kInf = 2 * Negamax<5, 5>::kGameOverEval;
+    for (Negamax<5, 5>* searcher : {&with_cache, &without_cache}) {
+      searcher->SetRootSituation(sit);
+      searcher->ID_depth = kDepth;
+    }
+    global_metrics = {};
+    const int eval = with_cache.NegamaxEval(kDepth, -kInf, kInf);
+    if (kBenchmark) {
+      ASSERT_EQ((global_metrics.eval_cache_hits > 0), true);
+      ASSERT_EQ((global_metrics.eval_cache_saved_primitives > 0), true);
+    }
+    ASSERT_EQ(without_cache.NegamaxEval(kDepth, -kInf, kInf), eval);
+    ASSERT_EQ((with_cache.GetMove(sit, 100000, kDepth) ==
+               without_cache.GetMove(sit, 100000, kDepth)),
+              true);
+    return true;
+  }
+
+  bool NegamaxETCTest() {
+    Situation<5, 5> sit = StartingSituation<5, 5>();
+    Negamax<5, 5> negamaxer;
+    negamaxer.SetRootSituation(sit);
+    constexpr int kDepth = 4;
+    constexpr int kInf = 2 * Negamax<5, 5>::kGameOverEval;
+    negamaxer.ID_depth = kDepth;
+    Negamax<5, 5>::StagedMoves staged_moves(negamaxer, kDepth - 1, 0, {});
+    const Move first_move = staged_moves.Get(0)->move;
+    ScoredMove cutoff;
+    ASSERT_EQ(negamaxer.EnhancedTranspositionCutoff(staged_moves, kDepth, kInf,
+                                                    cutoff),
+              false);
+    // The child now has an exact eval in the TT.
+    const int eval =
+        negamaxer.ChildEval(first_move, kDepth, -kInf, kInf, false);
+    global_metrics = {};
+    ASSERT_EQ(negamaxer.EnhancedTranspositionCutoff(staged_moves, kDepth, eval,
+                                                    cutoff),
+              true);
+    ASSERT_EQ((cutoff.move == first_move), true);
+    ASSERT_EQ(cutoff.score, eval);
+    if (kBenchmark) ASSERT_EQ(global_metrics.etc_cutoffs, 1);
+    // The child does not refute a higher beta. The other children have no
+    // entries.
+    ASSERT_EQ(negamaxer.EnhancedTranspositionCutoff(staged_moves, kDepth,
+                                                    eval + 1, cutoff),
+              false);
+    // Nor a search that does not probe it.
+    negamaxer.SetEnhancedTranspositionCutoffs(2, 0);
+    ASSERT_EQ(negamaxer.EnhancedTranspositionCutoff(staged_moves, kDepth, eval,
+                                                    cutoff),
+              false);
+    return true;
+  }
+
+  bool NegamaxIIDTest() {
+    Situation<5, 5> sit = StartingSituation<5, 5>();
+    constexpr int kDepth = Negamax<5, 5>::kIIDMinDepth;
+    constexpr int kInf = 2 * Negamax<5, 5>::kGameOverEval;
+    Negamax<5, 5> with_iid;
+    Negamax<5, 5> without_iid;
+    without_iid.SetInternalIterativeDeepening(false);
+    std::array<int, 2> evals;
+    for (int i = 0; i < 2; ++i) {
+      Negamax<5, 5>& negamaxer = i == 0 ? with_iid : without_iid;
+      negamaxer.SetRootSituation(sit);
+      // Not the root, which does not use IID.
+      negamaxer.ID_depth = kDepth + 1;
+      global_metrics = {};
+      evals[i] = negamaxer.NegamaxEval(kDepth, -kInf, kInf);
+      // Only the node itself is deep enough.
+      if (kBenchmark) ASSERT_EQ(global_metrics.iid_searches, 1 - i);
+    }
+    ASSERT_EQ(evals[0], evals[1]);
+    return true;
+  }
+
+  bool NegamaxNullMoveTest() {
+    Situation<4, 4> sit = StartingSituation<4, 4>();
+    Negamax<4, 4> negamaxer;
+    negamaxer.SetNnue(NnueWeights<4, 4>::Random(1));
+    negamaxer.SetRootSituation(sit);
+    ASSERT_EQ(negamaxer.IsNullMoveCandidate(-10), true);
+    ASSERT_EQ(negamaxer.IsNullMoveCandidate(10), false);
+    // Passing twice restores everything.
+    const uint64_t hash = negamaxer.sit_hash_;
+    const uint64_t mirror_hash = negamaxer.sit_mirror_hash_;
+    const NnueAccumulator accumulator = negamaxer.nnue_accumulator_;
+    negamaxer.PassTurn();
+    ASSERT_EQ(negamaxer.sit_.turn, 1);
+    ASSERT_EQ(negamaxer.sit_hash_, SituationHash(negamaxer.sit_));
+    negamaxer.PassTurn();
+    ASSERT_EQ((negamaxer.sit_ == sit), true);
+    ASSERT_EQ(negamaxer.sit_hash_, hash);
+    ASSERT_EQ(negamaxer.sit_mirror_hash_, mirror_hash);
+    ASSERT_EQ((negamaxer.nnue_accumulator_ == accumulator), true);
+
+    // Only the horizontal edges and the vertical ones in the first column are
+    // left, so every edge is a bridge and no wall can be built.
+    for (int edge = 0; edge < NumRealAndFakeEdges(4, 4); ++edge) {
+      if (IsRealEdge(4, 4, edge) && !IsHorizontalEdge(edge) &&
+          (edge / 2) % 4 != 0)
+        sit.G.DeactivateEdge(edge);
+    }
+    negamaxer.SetRootSituation(sit);
+    const std::array<int, 2> goal_distances = negamaxer.GoalDistances();
+    ASSERT_EQ((goal_distances[0] > 2 && goal_distances[1] > 2), true);
+    ASSERT_EQ(negamaxer.IsNullMoveCandidate(-10), false);
+
+    // The search passes, and still finds a legal move.
+    sit = StartingSituation<4, 4>();
+    global_metrics = {};
+    ASSERT_EQ(sit.IsLegalMove(negamaxer.GetMove(sit, 100000, 6)), true);
+    if (kBenchmark) ASSERT_EQ((global_metrics.null_move_searches > 0), true);
+    return true;
+  }
+
+  bool GameSessionTest() {
+    GameSession<4, 4> session;
+    // Three plies picked by the AI, and their standard notation.
+    Negamax<4, 4> negamaxer;
+    Situation<4, 4> sit = StartingSituation<4, 4>();
+    std::vector<Move> moves;
+    std::string notation;
+    for (int i = 1; i <= 3; ++i) {
+      moves.push_back(negamaxer.GetMove(sit, 1000, 2));
+      notation += (i == 1 ? "" : " ") + std::to_string(i) + ". " +
+                  sit.MoveToStandardNotation(moves.back());
+      sit.ApplyMove(moves.back());
+    }
+    const std::string first_move =
+        StartingSituation<4, 4>().MoveToStandardNotation(moves[0]);
+
+    ASSERT_EQ(session.PlayMove(first_move), true);
+    ASSERT_EQ(session.PlayMove(first_move), false);
+    ASSERT_EQ(session.PlayMove(moves[1]), true);
+    ASSERT_EQ(session.NumPlies(), 2);
+    // Continuing the game only plays the new moves.
+    ASSERT_EQ(session.SyncWithStandardNotation(notation + " "), true);
+    ASSERT_EQ(session.NumPlies(), 3);
+    ASSERT_EQ((session.CurrentSituation() == sit), true);
+    // A different game is replayed from the start.
+    ASSERT_EQ(session.SyncWithStandardNotation("1. " + first_move), true);
+    ASSERT_EQ(session.NumPlies(), 1);
+    ASSERT_EQ(session.SyncWithStandardNotation(notation + " 4. zz"), false);
+
+    session.NewGame();
+    ASSERT_EQ(session.NumPlies(), 0);
+    for (int i = 0; i < 4 && !session.CurrentSituation().IsGameOver(); ++i) {
+      ASSERT_EQ(session.PlayMove(session.GetMove(50)), true);
+    }
+    return true;
+  }
 };
 
 }  // namespace wallwars
@@ -0,0 +1,167 @@
+#ifndef TIME_MANAGER_H_
+#define TIME_MANAGER_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <mutex>
+
+#include "utils.h"
+
+namespace wallwars {
+
+// How long a search may run, in milliseconds from its start.
+struct TimeLimits {
+  // No new iterative-deepening iteration starts after the soft limit.
+  int soft_millis = std::numeric_limits<int>::max();
+  // The search is aborted, at any depth, at the hard limit.
+  int hard_millis = std::numeric_limits<int>::max();
+  // Whether the search can also stop before the soft limit: when the best move
+  // has not changed for several iterations, or when the next iteration is not
+  // expected to finish before the hard limit. See `TimeManager`.
+  bool stop_early = false;
+};
+
+// Limits for a search with a fixed duration, which only stops early if the
+// search is complete.
+TimeLimits FixedTimeLimits(int millis) { return {millis, millis, false}; }
+
+// Parameters of `ClockTimeLimits`.
+constexpr int kClockMovesToGo = 20;
+constexpr int kClockHardToSoftRatio = 4;
+constexpr int kClockMaxFraction = 4;
+constexpr int kClockSafetyMillis = 100;
+
+// Limits for a player with `remaining_millis` left on its clock and
+// `increment_millis` added after each move. The soft limit is an even share of
+// the remaining time over `kClockMovesToGo` moves plus most of the increment.
+// The hard limit lets an unstable search take `kClockHardToSoftRatio` times
+// longer, but never more than `1 / kClockMaxFraction` of the remaining time.
+// `kClockSafetyMillis` are kept for the latency of sending the move.
+TimeLimits ClockTimeLimits(int remaining_millis, int increment_millis) {
+  const int available = std::max(remaining_millis - kClockSafetyMillis, 1);
+  TimeLimits limits;
+  limits.soft_millis = std::min(
+      available / kClockMovesToGo + increment_millis * 3 / 4, available);
+  limits.hard_millis =
+      std::max(std::min(limits.soft_millis * kClockHardToSoftRatio,
+                        available / kClockMaxFraction),
+               limits.soft_millis);
+  limits.stop_early = true;
+  return limits;
+}
+
+// Tracks the time of a search against its `TimeLimits`. The hard limit is
+// checked by polling: searchers call `Poll` every `kPollIntervalNodes` nodes,
+// which is cheaper than reading the clock at every node, and `Stopped` at every
+// node. All methods can be called from any thread.
+//
+// While pondering (see `Negamax::StartPondering`), the search has no limits
+// and only stops with `Stop`. `PonderHit` then sets the limits, counted from
+// the time of the hit.
+class TimeManager {
+ public:
+  static constexpr int kPollIntervalNodes = 1024;
+  // With `stop_early`, once the best move is the same after
+  // `kStableIterations` consecutive iterations, the search stops after
+  // `1 / kStableSoftLimitDivisor` of the soft limit. Also, the next iteration
+  // does not start if it is expected to hit the hard limit, which would waste
+  // most of its time. Its duration is extrapolated from the growth of the
+  // last two.
+  static constexpr int kStableIterations = 4;
+  static constexpr int kStableSoftLimitDivisor = 2;
+
+  void Start(const TimeLimits& limits) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    StartLocked(limits);
+    pondering_ = false;
+    stopped_ = false;
+  }
+
+  void StartPondering() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    StartLocked(TimeLimits());
+    pondering_ = true;
+    stopped_ = false;
+  }
+
+  void PonderHit(const TimeLimits& limits) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    StartLocked(limits);
+    pondering_ = false;
+  }
+
+  void Stop() { stopped_.store(true, std::memory_order_relaxed); }
+
+  bool Pondering() const { return pondering_.load(std::memory_order_relaxed); }
+
+  int ElapsedMillis() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return MillisSince(start_);
+  }
+  int SoftMillisLeft() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return limits_.soft_millis - MillisSince(start_);
+  }
+
+  // Stops the search if the hard limit has been reached.
+  void Poll() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (MillisSince(start_) >= limits_.hard_millis) Stop();
+  }
+
+  // Whether the search was stopped by `Stop` or by a `Poll` that found that
+  // the hard limit was reached.
+  bool Stopped() const { return stopped_.load(std::memory_order_relaxed); }
+
+  // Called after each completed iterative-deepening iteration. Returns whether
+  // the next one should start.
+  bool StartNextIteration(bool best_move_changed) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    const int elapsed = MillisSince(start_);
+    if (Stopped() || elapsed >= limits_.soft_millis) return false;
+    stable_iterations_ = best_move_changed ? 0 : stable_iterations_ + 1;
+    const int last_millis = std::max(elapsed - iteration_end_millis_[1], 1);
+    const int prev_millis =
+        std::max(iteration_end_millis_[1] - iteration_end_millis_[0], 1);
+    iteration_end_millis_ = {iteration_end_millis_[1], elapsed};
+    ++num_iterations_;
+    if (!limits_.stop_early) return true;
+    if (stable_iterations_ >= kStableIterations &&
+        elapsed >= limits_.soft_millis / kStableSoftLimitDivisor) {
+      return false;
+    }
+    const long long next_millis =
+        static_cast<long long>(last_millis) * last_millis / prev_millis;
+    return num_iterations_ < 2 || elapsed + next_millis < limits_.hard_millis;
+  }
+
+ private:
+  void StartLocked(const TimeLimits& limits) {
+    start_ = std::chrono::high_resolution_clock::now();
+    limits_ = limits;
+    stable_iterations_ = 0;
+    iteration_end_millis_ = {0, 0};
+    num_iterations_ = 0;
+  }
+
+  // Guards the members below, which a ponder hit changes during the search.
+  mutable std::mutex mutex_;
+  std::chrono::high_resolution_clock::time_point start_ =
+      std::chrono::high_resolution_clock::now();
+  TimeLimits limits_;
+  // Consecutive iterations that ended with the same best move.
+  int stable_iterations_ = 0;
+  // When the last two iterations ended, in milliseconds since the start.
+  std::array<int, 2> iteration_end_millis_ = {0, 0};
+  int num_iterations_ = 0;
+
+  std::atomic<bool> pondering_{false};
+  std::atomic<bool> stopped_{false};
+};
+
+}  // namespace wallwars
+
+#endif  // TIME_MANAGER_H_
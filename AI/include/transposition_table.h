@@ -1,12 +1,25 @@
 #ifndef TRANSPOSITION_TABLE_H_
 #define TRANSPOSITION_TABLE_H_
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <algorithm>
 #include <array>
 #include <bitset>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
 #include <limits>
+#include <new>
+#include <string>
 
 #include "constants.h"
 #include "graph.h"
+#include "macro_utils.h"
 #include "move.h"
 #include "situation.h"
 
@@ -18,11 +31,113 @@ constexpr int kEmptyFlag = -1;
 
 std::size_t kInvalidLocation = SIZE_MAX;
 
-// Todo: improve hash function.
+// Situations are hashed with Zobrist hashing: there is a random key for each
+// wall, for each player at each node, and for the turn, and the hash of a
+// situation is the xor of the keys of its features. This makes it possible
+// to compute the hash of a child situation from the hash of the parent in
+// constant time (see `MoveHashDelta`). The keys are generated at compile time
+// from a fixed seed, so hashes are the same across runs and builds.
+constexpr uint64_t kZobristSeed = 0x2545F4914F6CDD1DULL;
+
+// Splitmix64 pseudorandom number generator.
+constexpr uint64_t SplitMix64(uint64_t& state) {
+  uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+template <int R, int C>
+struct ZobristKeys {
+  // Key for the wall at each edge (only used for real edges).
+  std::array<uint64_t, NumRealAndFakeEdges(R, C)> walls;
+  // Key for each player at each node.
+  std::array<std::array<uint64_t, NumNodes(R, C)>, 2> tokens;
+  // Key for when it is P1's turn.
+  uint64_t turn;
+};
+
+template <int R, int C>
+constexpr ZobristKeys<R, C> MakeZobristKeys() {
+  ZobristKeys<R, C> keys{};
+  uint64_t state = kZobristSeed;
+  for (int edge = 0; edge < NumRealAndFakeEdges(R, C); ++edge) {
+    keys.walls[edge] = SplitMix64(state);
+  }
+  for (int player = 0; player < 2; ++player) {
+    for (int node = 0; node < NumNodes(R, C); ++node) {
+      keys.tokens[player][node] = SplitMix64(state);
+    }
+  }
+  keys.turn = SplitMix64(state);
+  return keys;
+}
+
+template <int R, int C>
+constexpr ZobristKeys<R, C> kZobristKeys = MakeZobristKeys<R, C>();
+
+// Keys such that hashing a situation with them gives the hash of its mirror
+// image (see `Situation::Mirrored`), except for the turn key, which is off by
+// one xor of `kZobristKeys::turn` because the turn flips. See
+// `SituationMirrorHash`.
 template <int R, int C>
-std::size_t SituationHash(const Situation<R, C>& sit) {
-  return (sit.tokens[0] | (sit.tokens[1] << 16)) ^
-         std::hash<std::bitset<NumRealAndFakeEdges(R, C)>>{}(sit.G.edges);
+constexpr ZobristKeys<R, C> MakeMirroredZobristKeys() {
+  const ZobristKeys<R, C> keys = MakeZobristKeys<R, C>();
+  ZobristKeys<R, C> mirrored_keys = keys;
+  for (int edge = 0; edge < NumRealAndFakeEdges(R, C); ++edge) {
+    if (IsRealEdge(R, C, edge))
+      mirrored_keys.walls[edge] = keys.walls[MirrorEdge(C, edge)];
+  }
+  for (int player = 0; player < 2; ++player) {
+    for (int node = 0; node < NumNodes(R, C); ++node) {
+      mirrored_keys.tokens[player][node] =
+          keys.tokens[1 - player][MirrorNode(C, node)];
+    }
+  }
+  return mirrored_keys;
+}
+
+template <int R, int C>
+constexpr ZobristKeys<R, C> kMirroredZobristKeys =
+    MakeMirroredZobristKeys<R, C>();
+
+// Computes the hash of `sit` from scratch.
+template <int R, int C>
+uint64_t SituationHash(const Situation<R, C>& sit,
+                       const ZobristKeys<R, C>& keys = kZobristKeys<R, C>) {
+  uint64_t hash = keys.tokens[0][sit.tokens[0]] ^ keys.tokens[1][sit.tokens[1]];
+  if (sit.turn == 1) hash ^= keys.turn;
+  for (int edge = 0; edge < NumRealAndFakeEdges(R, C); ++edge) {
+    if (IsRealEdge(R, C, edge) && !sit.G.edges[edge]) hash ^= keys.walls[edge];
+  }
+  return hash;
+}
+
+// Returns the value that has to be xor'ed to the hash of `sit` to get the hash
+// of the situation after playing `move` in `sit`. It is also the value that has
+// to be xor'ed to undo the move, where `sit` is the situation before the move.
+// With `kMirroredZobristKeys`, it is the same for the hash of the mirror image.
+template <int R, int C>
+inline uint64_t MoveHashDelta(
+    const Situation<R, C>& sit, Move move,
+    const ZobristKeys<R, C>& keys = kZobristKeys<R, C>) {
+  const int from = sit.tokens[sit.turn];
+  uint64_t delta = keys.turn;
+  if (move.token_change != 0) {
+    delta ^= keys.tokens[sit.turn][from] ^
+             keys.tokens[sit.turn][from + move.token_change];
+  }
+  for (int edge : move.edges) {
+    if (edge != -1) delta ^= keys.walls[edge];
+  }
+  return delta;
+}
+
+// Computes the hash of `sit.Mirrored()` without building it.
+template <int R, int C>
+uint64_t SituationMirrorHash(const Situation<R, C>& sit) {
+  return SituationHash(sit, kMirroredZobristKeys<R, C>) ^
+         kZobristKeys<R, C>.turn;
 }
 
 // Alpha-beta flags.
@@ -51,6 +166,66 @@ struct TTEntry {
   // lookahead, so they can be used for lower depths too. Depths up to 127 are
   // possible.
   int8_t depth;
+
+  // Search generation in which the entry was last written. See
+  // `TranspositionTable::generation`. Generation 0 is never live, so
+  // default-initialized entries count as empty.
+  uint8_t generation = 0;
+
+  // Whether `sit` is the mirror image of the canonical situation, i.e., the
+  // one with the smaller hash. A situation and its mirror image share an
+  // entry, which holds whichever of them was searched last. See
+  // `ContainsUpToMirror`.
+  uint8_t mirrored = 0;
+
+  // Checksum of the other fields (see `TTEntryChecksum`). Threads write entries
+  // without locks, so a thread may read an entry while another one writes it,
+  // and see fields from both writes. The checksum of such a mix does not match
+  // with high probability, so `TranspositionTable::Probe` rejects it.
+  uint64_t checksum = 0;
+};
+
+// Checksum of the fields of `entry` other than `checksum`.
+template <int R, int C>
+uint64_t TTEntryChecksum(const TTEntry<R, C>& entry) {
+  uint64_t state =
+      static_cast<uint64_t>(static_cast<uint16_t>(entry.eval)) |
+      static_cast<uint64_t>(static_cast<uint16_t>(entry.edge0)) << 16 |
+      static_cast<uint64_t>(static_cast<uint16_t>(entry.edge1)) << 32 |
+      static_cast<uint64_t>(static_cast<uint8_t>(entry.token_change)) << 48 |
+      static_cast<uint64_t>(static_cast<uint8_t>(entry.alpha_beta_flag)) << 56;
+  uint64_t checksum = SplitMix64(state);
+  state ^= static_cast<uint64_t>(static_cast<uint8_t>(entry.depth)) |
+           static_cast<uint64_t>(entry.generation) << 8 |
+           static_cast<uint64_t>(entry.mirrored) << 16 |
+           static_cast<uint64_t>(static_cast<uint8_t>(entry.sit.tokens[0]))
+               << 24 |
+           static_cast<uint64_t>(static_cast<uint8_t>(entry.sit.tokens[1]))
+               << 32 |
+           static_cast<uint64_t>(static_cast<uint8_t>(entry.sit.turn)) << 40;
+  checksum ^= SplitMix64(state);
+  return checksum ^
+         std::hash<std::bitset<NumRealAndFakeEdges(R, C)>>{}(entry.sit.G.edges);
+}
+
+// Number of buckets in the age histogram of `TTStatistics`. The last bucket
+// groups every older age.
+constexpr int kNumTTAgeBuckets = 4;
+
+// Summary of the contents of a transposition table, computed from a sample of
+// its entries.
+struct TTStatistics {
+  long long num_sampled_entries = 0;
+  // Entries that are not empty (see `TranspositionTable::IsEmpty`). The
+  // histograms below only count live entries.
+  long long num_live_entries = 0;
+  // Number of live entries by depth.
+  std::array<long long, kMaxDepth + 1> depths{};
+  // Number of live entries by alpha-beta flag (indexed by the flag constants).
+  std::array<long long, 4> flags{};
+  // Number of live entries by age, i.e., how many searches ago they were
+  // written. Age 0 is the current (or last) search.
+  std::array<long long, kNumTTAgeBuckets> ages{};
 };
 
 template <int R, int C>
@@ -59,42 +234,290 @@ constexpr int NumTTEntries() {
   return size_bytes / sizeof(TTEntry<R, C>);
 }
 
+// Header of a TT snapshot file. The entries are stored raw right after the
+// header, so a snapshot can only be loaded by a build with the same board
+// dimensions, entry layout, and hash function.
+struct TTSnapshotHeader {
+  char magic[8];
+  int32_t version;
+  int32_t R, C;
+  int32_t entry_size_bytes;
+  int64_t num_entries;
+  uint64_t hash_seed;
+  // The hash of the starting situation, to detect snapshots created with a
+  // different hash function.
+  uint64_t hash_check;
+  uint8_t generation;
+  uint8_t oldest_live_generation;
+};
+
+constexpr char kTTSnapshotMagic[8] = {'W', 'W', 'T', 'T', 'S', 'N', 'A', 'P'};
+constexpr int32_t kTTSnapshotVersion = 4;
+
+// The entries start at the first page boundary after the header so that they
+// can be mapped in place.
+constexpr std::size_t kTTSnapshotHeaderBytes = 4096;
+static_assert(sizeof(TTSnapshotHeader) <= kTTSnapshotHeaderBytes,
+              "TT snapshot header does not fit in its page");
+
 template <int R, int C>
 class TranspositionTable {
  public:
-  std::array<TTEntry<R, C>, NumTTEntries<R, C>()>* entries;
+  using EntryArray = std::array<TTEntry<R, C>, NumTTEntries<R, C>()>;
+  EntryArray* entries;
+
+  // The generation is increased at the start of every search. Entries written
+  // in generations in [`oldest_live_generation`, `generation`] are "live".
+  // Entries written in older generations count as empty. Live entries from
+  // previous searches are still valid, but they are the first to be evicted.
+  // This makes it possible to reuse the table across searches and games
+  // without reinitializing hundreds of MB.
+  uint8_t generation = 1;
+  uint8_t oldest_live_generation = 1;
 
+  // The entries live in an anonymous mapping, which is zero-filled, so every
+  // entry starts empty, and whose pages are only committed when they are first
+  // written. A `Negamax` that is only used for its move generator, e.g., by
+  // `Mcts`, costs no memory for its TT.
   TranspositionTable() {
-    entries = new std::array<TTEntry<R, C>, NumTTEntries<R, C>()>;
+    void* mapping = mmap(nullptr, sizeof(EntryArray), PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) throw std::bad_alloc();
+    mapping_ = mapping;
+    mapping_bytes_ = sizeof(EntryArray);
+    entries = reinterpret_cast<EntryArray*>(mapping);
+  }
+  ~TranspositionTable() { FreeEntries(); }
+  TranspositionTable(const TranspositionTable&) = delete;
+  TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+  // Starts a new search generation. Entries from previous searches are kept
+  // but have lower priority.
+  void NewSearch() {
+    if (generation == std::numeric_limits<uint8_t>::max()) {
+      // The counter is about to wrap around, which would bring old entries
+      // back to life, so this is the only time we pay for a full reset.
+      entries->fill(TTEntry<R, C>{});
+      generation = 1;
+      oldest_live_generation = 1;
+      return;
+    }
+    ++generation;
+  }
+
+  // Makes every entry count as empty in O(1), e.g., between games or
+  // benchmark samples.
+  void Clear() {
+    NewSearch();
+    oldest_live_generation = generation;
   }
-  ~TranspositionTable() { delete entries; }
 
   // returns the index in `entries` where `sit` should go.
   inline std::size_t Location(const Situation<R, C>& sit) {
-    return SituationHash<R, C>(sit) % NumTTEntries<R, C>();
+    return HashLocation(SituationHash<R, C>(sit));
+  }
+  // Same as `Location`, but for a situation with hash `hash`.
+  inline std::size_t HashLocation(uint64_t hash) {
+    return hash % NumTTEntries<R, C>();
+  }
+
+  // Hints the CPU to start loading the entry at `location` into the cache, so
+  // that it is (hopefully) there when we read it.
+  inline void Prefetch(std::size_t location) {
+    PREFETCH(&(*entries)[location]);
   }
   inline bool Contains(std::size_t location, const Situation<R, C>& sit) {
-    return (*entries)[location].sit == sit;
+    TTEntry<R, C> entry;
+    return Probe(location, sit, /*mirrored=*/false, entry) && entry.sit == sit;
+  }
+  // Whether the entry at `location` is for `sit` or its mirror image.
+  // `mirrored` indicates whether `sit` is the mirror image of the canonical
+  // situation (see `TTEntry::mirrored`).
+  inline bool ContainsUpToMirror(std::size_t location,
+                                 const Situation<R, C>& sit, bool mirrored) {
+    TTEntry<R, C> entry;
+    return Probe(location, sit, mirrored, entry);
+  }
+  // Copies the entry at `location` to `entry`, and returns whether it is a
+  // consistent entry for `sit` or its mirror image, as in
+  // `ContainsUpToMirror`. Another thread may write the entry at any time, so
+  // only the copy can be trusted (see `TTEntry::checksum`).
+  inline bool Probe(std::size_t location, const Situation<R, C>& sit,
+                    bool mirrored, TTEntry<R, C>& entry) {
+    entry = (*entries)[location];
+    if (entry.alpha_beta_flag == kEmptyEntry ||
+        entry.generation < oldest_live_generation ||
+        entry.checksum != TTEntryChecksum(entry))
+      return false;
+    if (entry.mirrored == mirrored) return entry.sit == sit;
+    return entry.sit.IsMirrorOf(sit);
   }
   inline bool IsEmpty(std::size_t location) {
-    return (*entries)[location].alpha_beta_flag == kEmptyEntry;
+    const TTEntry<R, C>& entry = (*entries)[location];
+    return entry.alpha_beta_flag == kEmptyEntry ||
+           entry.generation < oldest_live_generation;
+  }
+  // Whether the entry at `location` was written before the current search.
+  inline bool IsFromPreviousSearch(std::size_t location) {
+    return (*entries)[location].generation != generation;
+  }
+
+  // Replacement policy: a result for `sit` at `depth` may overwrite the entry
+  // at `location` if the entry is empty, it is for the same situation, it is
+  // from a previous search, or it is not deeper than `depth`. The entry of
+  // the mirror image of `sit` counts as the same situation. See
+  // `ContainsUpToMirror` for `mirrored`.
+  inline bool CanStore(std::size_t location, const Situation<R, C>& sit,
+                       int depth, bool mirrored = false) {
+    if (IsEmpty(location) || IsFromPreviousSearch(location)) return true;
+    return (*entries)[location].depth <= depth ||
+           ContainsUpToMirror(location, sit, mirrored);
   }
 
   // `location` should equal Location(sit).
   inline void Insert(std::size_t location, const Situation<R, C>& sit,
                      int8_t alpha_beta_flag, int8_t depth, int16_t eval,
                      Move best_move) {
-    TTEntry<R, C>& entry = (*entries)[location];
+    TTEntry<R, C> entry;
     entry.sit = sit;
     entry.alpha_beta_flag = alpha_beta_flag;
     entry.depth = depth;
     entry.eval = eval;
-    entry.best_move = best_move;
+    entry.token_change = static_cast<int8_t>(best_move.token_change);
+    entry.edge0 = static_cast<int16_t>(best_move.edges[0]);
+    entry.edge1 = static_cast<int16_t>(best_move.edges[1]);
+    entry.generation = generation;
+    entry.mirrored = 0;
+    Store(location, entry);
+  }
+  // Writes `entry` at `location` with its checksum.
+  inline void Store(std::size_t location, TTEntry<R, C> entry) {
+    entry.checksum = TTEntryChecksum(entry);
+    (*entries)[location] = entry;
   }
 
   inline TTEntry<R, C>& Entry(std::size_t location) {
     return (*entries)[location];
   }
+
+  // Returns statistics about the contents of the table based on at most
+  // `max_samples` entries, evenly spaced. Entries are placed by hash, so an
+  // evenly spaced sample is representative of the whole table.
+  TTStatistics Statistics(long long max_samples) {
+    TTStatistics stats;
+    const long long num_entries = NumTTEntries<R, C>();
+    const long long stride = std::max(1LL, num_entries / max_samples);
+    for (long long location = 0; location < num_entries; location += stride) {
+      ++stats.num_sampled_entries;
+      if (IsEmpty(location)) continue;
+      const TTEntry<R, C>& entry = (*entries)[location];
+      ++stats.num_live_entries;
+      ++stats.depths[std::min<int>(std::max<int>(entry.depth, 0), kMaxDepth)];
+      ++stats.flags[entry.alpha_beta_flag];
+      const int age = static_cast<uint8_t>(generation - entry.generation);
+      ++stats.ages[std::min(age, kNumTTAgeBuckets - 1)];
+    }
+    return stats;
+  }
+
+  // Writes the table to `file_name`. Returns whether it succeeded.
+  bool Save(const std::string& file_name) const {
+    std::ofstream fout(file_name, std::ios::binary);
+    if (!fout.is_open()) {
+      std::cerr << "Could not open " << file_name << std::endl;
+      return false;
+    }
+    std::array<char, kTTSnapshotHeaderBytes> header_page{};
+    TTSnapshotHeader header = ExpectedSnapshotHeader();
+    std::memcpy(header_page.data(), &header, sizeof(header));
+    fout.write(header_page.data(), header_page.size());
+    fout.write(reinterpret_cast<const char*>(entries), sizeof(EntryArray));
+    return fout.good();
+  }
+
+  // Replaces the table with the snapshot in `file_name`, created by `Save()`.
+  // The file is mapped privately, so pages are read lazily as they are probed
+  // and writes during the search do not modify the file. Returns whether it
+  // succeeded. On failure, the table is unchanged.
+  bool Load(const std::string& file_name) {
+    std::FILE* file = std::fopen(file_name.c_str(), "rb");
+    if (file == nullptr) {
+      std::cerr << "Could not open " << file_name << std::endl;
+      return false;
+    }
+    TTSnapshotHeader header;
+    bool read_ok = std::fread(&header, sizeof(header), 1, file) == 1;
+    TTSnapshotHeader expected = ExpectedSnapshotHeader();
+    if (!read_ok || std::memcmp(header.magic, expected.magic, 8) != 0 ||
+        header.version != expected.version || header.R != R ||
+        header.C != C || header.entry_size_bytes != expected.entry_size_bytes ||
+        header.num_entries != expected.num_entries ||
+        header.hash_seed != expected.hash_seed ||
+        header.hash_check != expected.hash_check) {
+      std::cerr << "TT snapshot " << file_name
+                << " is not compatible with this build" << std::endl;
+      std::fclose(file);
+      return false;
+    }
+    const std::size_t mapping_bytes =
+        kTTSnapshotHeaderBytes + sizeof(EntryArray);
+    // Pages of the mapping past the end of the file would raise SIGBUS when
+    // probed.
+    struct stat file_stat;
+    if (fstat(fileno(file), &file_stat) != 0 ||
+        static_cast<std::size_t>(file_stat.st_size) < mapping_bytes) {
+      std::cerr << "TT snapshot " << file_name << " is truncated" << std::endl;
+      std::fclose(file);
+      return false;
+    }
+    void* mapping = mmap(nullptr, mapping_bytes, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE, fileno(file), 0);
+    // The mapping stays valid after closing the file.
+    std::fclose(file);
+    if (mapping == MAP_FAILED) {
+      std::cerr << "Could not map " << file_name << std::endl;
+      return false;
+    }
+    FreeEntries();
+    mapping_ = mapping;
+    mapping_bytes_ = mapping_bytes;
+    entries = reinterpret_cast<EntryArray*>(static_cast<char*>(mapping) +
+                                            kTTSnapshotHeaderBytes);
+    generation = header.generation;
+    oldest_live_generation = header.oldest_live_generation;
+    return true;
+  }
+
+ private:
+  // The mapping that holds the entries: an anonymous one, or, if the entries
+  // come from `Load()`, a private file mapping, where they start after the
+  // header.
+  void* mapping_ = nullptr;
+  std::size_t mapping_bytes_ = 0;
+
+  void FreeEntries() {
+    if (mapping_ != nullptr) munmap(mapping_, mapping_bytes_);
+    mapping_ = nullptr;
+    entries = nullptr;
+  }
+
+  TTSnapshotHeader ExpectedSnapshotHeader() const {
+    TTSnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, kTTSnapshotMagic, 8);
+    header.version = kTTSnapshotVersion;
+    header.R = R;
+    header.C = C;
+    header.entry_size_bytes = sizeof(TTEntry<R, C>);
+    header.num_entries = NumTTEntries<R, C>();
+    header.hash_seed = kZobristSeed;
+    header.hash_check = SituationHash<R, C>(StartingSituation<R, C>());
+    header.generation = generation;
+    header.oldest_live_generation = oldest_live_generation;
+    return header;
+  }
+
+  friend class Tests;
 };
 
 }  // namespace wallwars
@@ -0,0 +1,163 @@
+#ifndef WORK_STEALING_POOL_H_
+#define WORK_STEALING_POOL_H_
+
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace wallwars {
+
+// A pool of threads where each thread has its own deque of tasks. Threads push
+// and pop tasks at the back of their own deque, and, when it is empty, they
+// steal tasks from the front of the deques of other threads. Tasks are grouped
+// in `TaskGroup`s so that the thread that submits them can wait for them.
+//
+// The thread that creates the pool is part of it (with index 0): it does not
+// run tasks in the background, but it runs its own tasks while it waits for
+// them. The other `num_threads - 1` threads are started by the pool.
+class WorkStealingPool {
+ public:
+  using Task = std::function<void()>;
+
+  // A set of tasks that can be waited for.
+  struct TaskGroup {
+    std::atomic<int> num_pending_tasks{0};
+  };
+
+  // `at_thread_exit` is called by each thread started by the pool right before
+  // it finishes, e.g., to collect thread-local data.
+  WorkStealingPool(int num_threads,
+                   std::function<void()> at_thread_exit = nullptr) {
+    for (int i = 0; i < num_threads; ++i) {
+      deques_.push_back(std::make_unique<TaskDeque>());
+    }
+    for (int i = 1; i < num_threads; ++i) {
+      threads_.emplace_back([this, i, at_thread_exit]() {
+        thread_pool_ = this;
+        thread_index_ = i;
+        WorkerLoop();
+        if (at_thread_exit) at_thread_exit();
+      });
+    }
+  }
+
+  // Waits for the threads to finish their current task.
+  ~WorkStealingPool() {
+    stop_ = true;
+    for (std::thread& thread : threads_) thread.join();
+  }
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  int NumThreads() const { return static_cast<int>(deques_.size()); }
+
+  // Adds `task` to the deque of the calling thread.
+  void Submit(TaskGroup& group, Task task) {
+    group.num_pending_tasks.fetch_add(1, std::memory_order_relaxed);
+    TaskDeque& deque = *deques_[ThreadIndex()];
+    std::lock_guard<std::mutex> lock(deque.mutex);
+    deque.tasks.push_back({std::move(task), &group});
+  }
+
+  // Returns when every task in `group` has finished. Meanwhile, the calling
+  // thread runs the tasks of `group` that were not stolen by other threads.
+  // It does not run other tasks, which could take much longer than `group`.
+  void Wait(TaskGroup& group) {
+    TaskDeque& deque = *deques_[ThreadIndex()];
+    while (group.num_pending_tasks.load(std::memory_order_acquire) > 0) {
+      QueuedTask queued_task;
+      bool found = false;
+      {
+        std::lock_guard<std::mutex> lock(deque.mutex);
+        // Tasks are popped in LIFO order, so the tasks of `group` are at the
+        // back, after the tasks of any group the thread waits for further up
+        // in the stack.
+        if (!deque.tasks.empty() && deque.tasks.back().group == &group) {
+          queued_task = std::move(deque.tasks.back());
+          deque.tasks.pop_back();
+          found = true;
+        }
+      }
+      if (found) {
+        Run(queued_task);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+ private:
+  struct QueuedTask {
+    Task task;
+    TaskGroup* group;
+  };
+
+  struct TaskDeque {
+    std::mutex mutex;
+    std::deque<QueuedTask> tasks;
+  };
+
+  // The pool and index of the calling thread, if it was started by a pool.
+  static inline thread_local WorkStealingPool* thread_pool_ = nullptr;
+  static inline thread_local int thread_index_ = 0;
+
+  // Threads not started by this pool have index 0.
+  int ThreadIndex() const {
+    return thread_pool_ == this ? thread_index_ : 0;
+  }
+
+  static void Run(QueuedTask& queued_task) {
+    queued_task.task();
+    queued_task.group->num_pending_tasks.fetch_sub(1,
+                                                    std::memory_order_release);
+  }
+
+  void WorkerLoop() {
+    const int index = thread_index_;
+    while (!stop_) {
+      QueuedTask queued_task;
+      if (PopOwnTask(index, queued_task) || StealTask(index, queued_task)) {
+        Run(queued_task);
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  bool PopOwnTask(int index, QueuedTask& queued_task) {
+    TaskDeque& deque = *deques_[index];
+    std::lock_guard<std::mutex> lock(deque.mutex);
+    if (deque.tasks.empty()) return false;
+    queued_task = std::move(deque.tasks.back());
+    deque.tasks.pop_back();
+    return true;
+  }
+
+  // Tries the other threads in round-robin order starting after `index`.
+  // Stealing from the front takes the oldest tasks, which are the closest to
+  // the root of the search and thus the biggest.
+  bool StealTask(int index, QueuedTask& queued_task) {
+    for (int i = 1; i < NumThreads(); ++i) {
+      TaskDeque& deque = *deques_[(index + i) % NumThreads()];
+      std::lock_guard<std::mutex> lock(deque.mutex);
+      if (deque.tasks.empty()) continue;
+      queued_task = std::move(deque.tasks.front());
+      deque.tasks.pop_front();
+      return true;
+    }
+    return false;
+  }
+
+  std::vector<std::unique_ptr<TaskDeque>> deques_;
+  std::vector<std::thread> threads_;
+  std::atomic<bool> stop_{false};
+};
+
+}  // namespace wallwars
+
+#endif  // WORK_STEALING_POOL_H_
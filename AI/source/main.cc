@@ -3,15 +3,33 @@
 
 #include "benchmark.h"
 #include "interactive_game.h"
+#include "puzzle_solver.h"
 #include "tests.h"
 
 int main(int argc, char* argv[]) {
   if (argc > 1) {
     std::string menu_option = argv[1];
     if (menu_option == "play") {
-      wallwars::InteractiveGame::PlayGame();
+      // Optional number of search threads, e.g., "play 4".
+      int num_threads = 1;
+      if (argc > 2) num_threads = std::stoi(argv[2]);
+      wallwars::InteractiveGame::PlayGame(num_threads);
     } else if (menu_option == "test") {
       wallwars::Tests::RunTests();
+    } else if (menu_option == "solve") {
+      // E.g., solve 3 7 "1. c1 2. e1 3. a1> a2>", with an optional node
+      // budget at the end.
+      if (argc < 5) {
+        std::cout << "Usage: solve <rows> <columns> <standard notation> "
+                     "[max nodes]"
+                  << std::endl;
+        return 1;
+      }
+      long long max_nodes = wallwars::kSolveMaxNodes;
+      if (argc > 5) max_nodes = std::stoll(argv[5]);
+      if (!wallwars::SolvePuzzle(std::stoi(argv[2]), std::stoi(argv[3]),
+                                 argv[4], max_nodes))
+        return 1;
     } else if (menu_option == "benchmark") {
       std::string comparison_file = "";
       if (argc > 2) comparison_file = argv[2];
@@ -2,25 +2,31 @@
 
 #include <string>
 
+#include "../../AI/include/game_session.h"
 #include "../../AI/include/move.h"
-#include "../../AI/include/negamax.h"
 #include "../../AI/include/situation.h"
 
+namespace {
+
+// Kept between calls, so that each move is searched with what was learned
+// while searching the previous ones in the same game.
+wallwars::GameSession<wallwars::kBrowserR, wallwars::kBrowserC> session;
+
+}  // namespace
+
 // C-API to be used in JS via the emscripten pipeline.
 extern "C" {
 
 EMSCRIPTEN_KEEPALIVE char const* GetMove(char const* standard_notation) {
-  char* c;
-  {
-    wallwars::Situation<wallwars::kBrowserR, wallwars::kBrowserC> sit =
-        wallwars::ParseSituationOrCrash<wallwars::kBrowserR,
-                                        wallwars::kBrowserC>(standard_notation);
-    wallwars::Negamax<wallwars::kBrowserR, wallwars::kBrowserC> negamax;
-    // Expects that the game is not over, i.e., no player is at their goal.
-    wallwars::Move move = negamax.GetMove(sit, wallwars::kBrowserMillis);
-    std::string move_str = sit.MoveToStandardNotation(move);
-    c = strdup(move_str.c_str());
+  if (!session.SyncWithStandardNotation(standard_notation)) {
+    // Crashes with the parsing error.
+    wallwars::ParseSituationOrCrash<wallwars::kBrowserR, wallwars::kBrowserC>(
+        standard_notation);
   }
-  return c;
+  // Expects that the game is not over, i.e., no player is at their goal.
+  wallwars::Move move = session.GetMove(wallwars::kBrowserMillis);
+  std::string move_str =
+      session.CurrentSituation().MoveToStandardNotation(move);
+  return strdup(move_str.c_str());
 }
 }